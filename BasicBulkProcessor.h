@@ -0,0 +1,225 @@
+/**
+ * @file BasicBulkProcessor.h
+ * @brief Шаблон процессора команд с политиками блокировки, часов и приемника
+ */
+
+#pragma once
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * @struct NullLock
+ * @brief Политика блокировки для однопоточного использования: блокировка не выполняется
+ */
+struct NullLock
+{
+	void lock() {}
+	void unlock() {}
+};
+
+/**
+ * @struct SystemClock
+ * @brief Политика часов: системное время в наносекундах
+ */
+struct SystemClock
+{
+	int64_t now() const {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+};
+
+/**
+ * @struct NullClock
+ * @brief Политика часов, не читающая время: время создания всех блоков равно 0
+ */
+struct NullClock
+{
+	int64_t now() const { return 0; }
+};
+
+/**
+ * @class BasicBulkProcessor
+ * @brief Разбор команд и формирование блоков, полностью определяемые на этапе компиляции.
+ * @tparam LockPolicy Тип с lock()/unlock(): std::mutex или NullLock
+ * @tparam ClockPolicy Тип с int64_t now(): SystemClock, FastClock (FastClock.h) или NullClock
+ * @tparam SinkPolicy Получатель блоков с методом write(std::vector<std::string>& commands, int64_t created_ns);
+ *         команды можно забрать перемещением. Необязательные методы вызываются, если объявлены:
+ *         opened(int64_t created_ns) - первая команда блока, added(std::string_view) - команда добавлена,
+ *         entered()/left() - вход в динамический блок и выход из него, parsed() - конец вызова parse,
+ *         finalized(size_t depth) - конец finalize, bool over_budget() - открытый блок нужно передать
+ *         досрочно (динамический блок передается частями, глубина вложенности сохраняется).
+ *
+ * Команды "{" и "}" разбираются напрямую, без виртуальных вызовов. С NullLock, NullClock
+ * и приемником без необязательных методов путь от parse до write встраивается в один цикл.
+ * Все методы приемника вызываются под блокировкой LockPolicy.
+ */
+template<typename LockPolicy, typename ClockPolicy, typename SinkPolicy>
+class BasicBulkProcessor
+{
+public:
+	/**
+	* @brief Конструктор процессора
+	* @param block_size Размер статического блока команд
+	* @param sink_args Аргументы конструктора приемника
+	*/
+	template<typename... SinkArgs>
+	explicit BasicBulkProcessor(size_t block_size, SinkArgs&&... sink_args)
+		: block_size_(block_size), sink_(std::forward<SinkArgs>(sink_args)...) {
+	}
+
+	/// @brief Возвращает приемник блоков
+	SinkPolicy& sink() { return sink_; }
+	/// @brief Возвращает приемник блоков
+	const SinkPolicy& sink() const { return sink_; }
+
+	/**
+	* @brief Обрабатывает входную строку команд
+	* @param input Команды, разделенные переводом строки или последовательностью "\\n"
+	*/
+	void parse(std::string_view input) {
+		size_t start = input.find_first_not_of(" \t");
+		if (start == std::string_view::npos)
+			return;
+		size_t pos = start;
+		while ((pos = input.find_first_of("\n\\", pos)) != std::string_view::npos) {
+			size_t separator = input[pos] == '\n' ? 1 : (pos + 1 < input.size() && input[pos + 1] == 'n' ? 2 : 0);
+			if (separator == 0) {
+				++pos;
+				continue;
+			}
+			if (pos > start)
+				process(input.substr(start, pos - start));
+			pos += separator;
+			start = pos;
+		}
+		if (start < input.size())
+			process(input.substr(start));
+		if constexpr (requires(SinkPolicy& sink) { sink.parsed(); }) {
+			std::lock_guard lock(mutex_);
+			sink_.parsed();
+		}
+	}
+
+	/**
+	* @brief Начинает новый динамический блок команд
+	*/
+	void startBlock() {
+		std::lock_guard lock(mutex_);
+		if (depth_ == 0)
+			flush();
+		++depth_;
+		dynamic_ = true;
+		if constexpr (requires(SinkPolicy& sink) { sink.entered(); })
+			sink_.entered();
+	}
+
+	/**
+	* @brief Завершает текущий динамический блок команд
+	*/
+	void endBlock() {
+		std::lock_guard lock(mutex_);
+		if (depth_ == 0)
+			return;
+		--depth_;
+		if constexpr (requires(SinkPolicy& sink) { sink.left(); })
+			sink_.left();
+		if (depth_ == 0)
+			flush();
+	}
+
+	/**
+	* @brief Добавляет команду в текущий блок
+	*/
+	void addCommand(std::string_view command) {
+		std::lock_guard lock(mutex_);
+		if (commands_.empty()) {
+			created_ns_ = clock_.now();
+			if constexpr (requires(SinkPolicy& sink) { sink.opened(int64_t{}); })
+				sink_.opened(created_ns_);
+		}
+		commands_.emplace_back(command);
+		if constexpr (requires(SinkPolicy& sink) { sink.added(command); })
+			sink_.added(command);
+		if (!dynamic_ && commands_.size() >= block_size_)
+			flush();
+		else if constexpr (requires(SinkPolicy& sink) { { sink.over_budget() } -> std::convertible_to<bool>; }) {
+			if (sink_.over_budget())
+				flushPart();
+		}
+	}
+
+	/**
+	* @brief Завершает обработку: сбрасывает статический блок, незакрытый динамический отбрасывает
+	*/
+	void finalize() {
+		std::lock_guard lock(mutex_);
+		if (depth_ == 0)
+			flush();
+		else
+			commands_.clear();
+		if constexpr (requires(SinkPolicy& sink) { sink.finalized(size_t{}); })
+			sink_.finalized(depth_);
+	}
+
+	/**
+	* @brief Заменяет открытый блок сохраненным состоянием
+	* @param commands Команды блока
+	* @param depth Глубина вложенности динамического блока
+	* @param created_ns Время создания блока
+	*/
+	void restore(std::vector<std::string> commands, size_t depth, int64_t created_ns) {
+		std::lock_guard lock(mutex_);
+		commands_ = std::move(commands);
+		depth_ = depth;
+		dynamic_ = depth > 0;
+		created_ns_ = created_ns;
+	}
+
+private:
+	/**
+	* @brief Обрабатывает одну команду
+	*/
+	void process(std::string_view command) {
+		if (command == "{")
+			startBlock();
+		else if (command == "}")
+			endBlock();
+		else
+			addCommand(command);
+	}
+
+	/**
+	* @brief Передает непустой блок приемнику и начинает новый (вызывается под блокировкой)
+	*/
+	void flush() {
+		if (commands_.empty())
+			return;
+		flushPart();
+		dynamic_ = false;
+		depth_ = 0;
+	}
+
+	/**
+	* @brief Передает команды открытого блока приемнику, сохраняя вложенность (вызывается под блокировкой)
+	*/
+	void flushPart() {
+		sink_.write(commands_, created_ns_);
+		commands_.clear();
+		created_ns_ = 0;
+	}
+
+	size_t block_size_; ///< Размер статического блока
+	std::vector<std::string> commands_; ///< Команды открытого блока
+	bool dynamic_{ false }; ///< Открыт динамический блок
+	size_t depth_{ 0 }; ///< Глубина вложенности динамического блока
+	int64_t created_ns_{ 0 }; ///< Время создания открытого блока
+	[[no_unique_address]] LockPolicy mutex_;
+	[[no_unique_address]] ClockPolicy clock_;
+	SinkPolicy sink_;
+};
\ No newline at end of file
@@ -0,0 +1,203 @@
+/**
+ * @file BlockJournal.cpp
+ * @brief Реализация журнала открытого блока
+ */
+#include "BlockJournal.h"
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace {
+	/// @brief Размер журнала, после которого он усекается при сбросе блока
+	constexpr size_t COMPACT_BYTES = 1 << 20;
+
+	void appendVarint(std::string& out, uint64_t value) {
+		for (; value >= 0x80; value >>= 7)
+			out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+		out.push_back(static_cast<char>(value));
+	}
+
+	bool readVarint(std::string_view& in, uint64_t& value) {
+		value = 0;
+		for (int shift = 0; shift < 64 && !in.empty(); shift += 7) {
+			auto byte = static_cast<unsigned char>(in.front());
+			in.remove_prefix(1);
+			value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+			if (!(byte & 0x80))
+				return true;
+		}
+		return false;
+	}
+}
+
+BlockJournal::BlockJournal(std::filesystem::path path) : path_(std::move(path))
+{
+	std::error_code ec;
+	if (path_.has_parent_path())
+		std::filesystem::create_directories(path_.parent_path(), ec);
+	file_ = std::fopen(path_.string().c_str(), "ab");
+	if (!file_) {
+		std::cerr << "Error opening journal: " << path_ << std::endl;
+		return;
+	}
+	bytes_ = static_cast<size_t>(std::filesystem::file_size(path_, ec));
+}
+
+BlockJournal::~BlockJournal()
+{
+	if (file_) {
+		commit();
+		std::fclose(file_);
+	}
+}
+
+bool BlockJournal::load(const std::filesystem::path& path, State& state)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+	std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	std::string_view in = data;
+	state = {};
+	while (!in.empty()) {
+		char record = in.front();
+		in.remove_prefix(1);
+		if (record == Open) {
+			if (in.size() < sizeof(int64_t))
+				break; // Оборванная запись
+			uint64_t ns = 0;
+			for (size_t i = 0; i < sizeof(ns); ++i)
+				ns |= static_cast<uint64_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+			in.remove_prefix(sizeof(ns));
+			state.created_ns = static_cast<int64_t>(ns);
+		}
+		else if (record == Command) {
+			uint64_t length = 0;
+			if (!readVarint(in, length) || in.size() < length)
+				break;
+			state.commands.emplace_back(in.substr(0, length));
+			in.remove_prefix(length);
+		}
+		else if (record == Enter)
+			++state.depth;
+		else if (record == Leave) {
+			if (state.depth > 0)
+				--state.depth;
+		}
+		else if (record == Flush) {
+			state.commands.clear();
+			state.created_ns = 0;
+		}
+		else
+			break; // Поврежденный хвост
+	}
+	return true;
+}
+
+std::filesystem::path BlockJournal::pathFor(const std::filesystem::path& dir, std::string_view session)
+{
+	static const char hex[] = "0123456789abcdef";
+	std::string name;
+	for (char c : session) {
+		if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_')
+			name.push_back(c);
+		else {
+			name.push_back('%');
+			name.push_back(hex[static_cast<unsigned char>(c) >> 4]);
+			name.push_back(hex[static_cast<unsigned char>(c) & 0x0F]);
+		}
+	}
+	return dir / (name + ".journal");
+}
+
+void BlockJournal::open(int64_t created_ns)
+{
+	buffer_.push_back(Open);
+	for (size_t i = 0; i < sizeof(created_ns); ++i)
+		buffer_.push_back(static_cast<char>((static_cast<uint64_t>(created_ns) >> (8 * i)) & 0xFF));
+}
+
+void BlockJournal::command(std::string_view command)
+{
+	buffer_.push_back(Command);
+	appendVarint(buffer_, command.size());
+	buffer_.append(command);
+}
+
+void BlockJournal::enter()
+{
+	buffer_.push_back(Enter);
+}
+
+void BlockJournal::leave()
+{
+	buffer_.push_back(Leave);
+}
+
+void BlockJournal::flushed(size_t depth)
+{
+	if (file_ && bytes_ + buffer_.size() >= COMPACT_BYTES) { // Команд не осталось: журнал можно начать заново
+		State state;
+		state.depth = depth;
+		if (rewrite(state))
+			return;
+	}
+	buffer_.push_back(Flush);
+}
+
+bool BlockJournal::rewrite(const State& state)
+{
+	std::string pending = std::move(buffer_);
+	buffer_.clear();
+	if (!state.commands.empty())
+		open(state.created_ns);
+	for (size_t i = 0; i < state.depth; ++i)
+		enter();
+	for (const auto& command : state.commands)
+		this->command(command);
+
+	std::filesystem::path temp = path_;
+	temp += ".tmp";
+	std::FILE* file = std::fopen(temp.string().c_str(), "wb");
+	bool written = file && std::fwrite(buffer_.data(), 1, buffer_.size(), file) == buffer_.size();
+	if (file)
+		written = std::fclose(file) == 0 && written;
+	std::error_code ec;
+	if (written)
+		std::filesystem::rename(temp, path_, ec);
+	if (!written || ec) {
+		std::cerr << "Error compacting journal: " << path_ << std::endl;
+		std::filesystem::remove(temp, ec);
+		buffer_ = std::move(pending); // Прежний журнал и несохраненные записи остаются в силе
+		return false;
+	}
+
+	if (file_)
+		std::fclose(file_);
+	file_ = std::fopen(path_.string().c_str(), "ab");
+	if (!file_)
+		std::cerr << "Error opening journal: " << path_ << std::endl;
+	bytes_ = buffer_.size();
+	buffer_.clear();
+	return true;
+}
+
+void BlockJournal::commit()
+{
+	if (!file_ || buffer_.empty())
+		return;
+	bytes_ += std::fwrite(buffer_.data(), 1, buffer_.size(), file_);
+	std::fflush(file_);
+	buffer_.clear();
+}
+
+void BlockJournal::remove()
+{
+	if (file_) {
+		std::fclose(file_);
+		file_ = nullptr;
+	}
+	buffer_.clear();
+	std::error_code ec;
+	std::filesystem::remove(path_, ec);
+}
\ No newline at end of file
@@ -0,0 +1,119 @@
+/**
+ * @file BlockJournal.h
+ * @brief Журнал упреждающей записи открытого блока команд
+ */
+
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @class BlockJournal
+ * @brief Дописываемый журнал изменений открытого блока одного процессора.
+ *
+ * Журнал хранит короткие записи: открытие блока (время создания), команда, вход в динамический
+ * блок и выход из него, сброс команд блока. После сброса команд не остается, поэтому разросшийся журнал
+ * в этот момент усекается до записей о текущей глубине вложенности. Записи накапливаются в буфере и передаются в файл вызовом
+ * commit() (после каждого receive), так что перезапуск процесса теряет не больше текущего вызова.
+ * Оборванная последняя запись при чтении отбрасывается.
+ */
+class BlockJournal
+{
+public:
+	/**
+	* @struct State
+	* @brief Состояние открытого блока, восстановленное из журнала
+	*/
+	struct State
+	{
+		std::vector<std::string> commands; ///< Команды открытого блока
+		size_t depth{ 0 }; ///< Глубина вложенности динамического блока
+		int64_t created_ns{ 0 }; ///< Время создания блока в наносекундах
+	};
+
+	/**
+	* @brief Открывает журнал для дописывания, создавая каталог при необходимости
+	* @param path Путь к файлу журнала
+	*/
+	explicit BlockJournal(std::filesystem::path path);
+
+	~BlockJournal();
+
+	BlockJournal(const BlockJournal&) = delete;
+	BlockJournal& operator=(const BlockJournal&) = delete;
+
+	/**
+	* @brief Читает состояние открытого блока из журнала
+	* @param path Путь к файлу журнала
+	* @param state Восстановленное состояние
+	* @return false если журнала нет
+	*/
+	static bool load(const std::filesystem::path& path, State& state);
+
+	/**
+	* @brief Возвращает путь к журналу сессии в каталоге dir
+	* @details Символы идентификатора, недопустимые в имени файла, кодируются.
+	*/
+	static std::filesystem::path pathFor(const std::filesystem::path& dir, std::string_view session);
+
+	/**
+	* @brief Проверяет, удалось ли открыть файл журнала
+	*/
+	bool is_open() const { return file_ != nullptr; }
+
+	/// @brief Первая команда нового блока
+	void open(int64_t created_ns);
+	/// @brief Команда добавлена в блок
+	void command(std::string_view command);
+	/// @brief Вход в динамический блок
+	void enter();
+	/// @brief Выход из динамического блока
+	void leave();
+	/**
+	* @brief Команды блока переданы в приемники
+	* @param depth Глубина вложенности после сброса (больше 0 при досрочной передаче динамического блока)
+	*/
+	void flushed(size_t depth);
+
+	/**
+	* @brief Заменяет содержимое журнала записями состояния state
+	* @return false если новый журнал не удалось записать (прежний остается без изменений)
+	* @details Вызывается при повторном подключении: журнал сжимается до состояния открытого блока,
+	*          и оборванная запись в конце не мешает дописыванию. Состояние пишется во временный файл
+	*          <path>.tmp, который затем атомарно заменяет журнал, поэтому сбой во время сжатия
+	*          оставляет прежний журнал целым.
+	*/
+	bool rewrite(const State& state);
+
+	/**
+	* @brief Передает накопленные записи в файл
+	*/
+	void commit();
+
+	/**
+	* @brief Закрывает и удаляет журнал (открытого блока больше нет)
+	*/
+	void remove();
+
+private:
+	/**
+	* @brief Тип записи журнала
+	*/
+	enum Record : char
+	{
+		Open = 'O',    ///< Время создания блока (8 байт)
+		Command = 'C', ///< Длина (varint) и текст команды
+		Enter = '{',   ///< Вход в динамический блок
+		Leave = '}',   ///< Выход из динамического блока
+		Flush = 'F'    ///< Команды блока сброшены, глубина вложенности сохраняется
+	};
+
+	std::filesystem::path path_; ///< Путь к файлу журнала
+	std::FILE* file_{ nullptr }; ///< Файл журнала
+	std::string buffer_; ///< Записи, еще не переданные в файл
+	size_t bytes_{ 0 }; ///< Размер файла журнала
+};
\ No newline at end of file
@@ -0,0 +1,106 @@
+/**
+ * @file BlockRecord.h
+ * @brief Двоичные записи блоков с временными метками
+ *
+ * Файл с записями начинается с сигнатуры BLOCK_RECORD_MAGIC, за которой следуют записи
+ * (все числа little-endian):
+ *   u32 размер записи без этого поля, u64 handle, u64 seq,
+ *   i64 created_ns, i64 flushed_ns, i64 written_ns, u32 количество команд,
+ *   для каждой команды u32 длина и байты команды.
+ */
+
+#pragma once
+#include "BlockSink.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// @brief Сигнатура файла двоичных записей
+constexpr std::string_view BLOCK_RECORD_MAGIC = "BULKREC1";
+
+/**
+ * @struct BlockRecord
+ * @brief Разобранная двоичная запись; команды ссылаются на исходный буфер
+ */
+struct BlockRecord
+{
+	uint64_t handle{ 0 }; ///< Идентификатор процессора
+	uint64_t seq{ 0 }; ///< Номер блока в пределах процессора
+	int64_t created_ns{ 0 }; ///< Получение первой команды блока
+	int64_t flushed_ns{ 0 }; ///< Отправка блока в приемники
+	int64_t written_ns{ 0 }; ///< Начало записи блока приемником
+	std::vector<std::string_view> commands; ///< Команды блока
+};
+
+/// @brief Дописывает младшие bytes байт числа в порядке little-endian
+inline void putRecordField(std::string& out, uint64_t value, size_t bytes)
+{
+	for (size_t i = 0; i < bytes; ++i)
+		out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+}
+
+/// @brief Читает число из bytes байт в порядке little-endian, отрезая их от in
+inline bool getRecordField(std::string_view& in, uint64_t& value, size_t bytes)
+{
+	if (in.size() < bytes)
+		return false;
+	value = 0;
+	for (size_t i = 0; i < bytes; ++i)
+		value |= static_cast<uint64_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+	in.remove_prefix(bytes);
+	return true;
+}
+
+/**
+ * @brief Дописывает двоичную запись блока
+ * @param out Приемник записи
+ * @param block Блок
+ * @param written_ns Время записи блока приемником
+ */
+inline void appendBlockRecord(std::string& out, const OutputBlock& block, int64_t written_ns)
+{
+	size_t size = 8 * 5 + 4 + 4 * block.commands.size() + block.bytes;
+	putRecordField(out, size, 4);
+	putRecordField(out, block.handle, 8);
+	putRecordField(out, block.seq, 8);
+	putRecordField(out, static_cast<uint64_t>(block.created_ns), 8);
+	putRecordField(out, static_cast<uint64_t>(block.flushed_ns), 8);
+	putRecordField(out, static_cast<uint64_t>(written_ns), 8);
+	putRecordField(out, block.commands.size(), 4);
+	for (const auto& command : block.commands) {
+		putRecordField(out, command.size(), 4);
+		out += command;
+	}
+}
+
+/**
+ * @brief Читает очередную двоичную запись
+ * @param in Данные после сигнатуры; прочитанная запись отрезается
+ * @param record Разобранная запись
+ * @return false если данные закончились или запись повреждена
+ */
+inline bool readBlockRecord(std::string_view& in, BlockRecord& record)
+{
+	uint64_t size = 0;
+	if (!getRecordField(in, size, 4) || in.size() < size)
+		return false;
+	std::string_view body = in.substr(0, size);
+	in.remove_prefix(size);
+	uint64_t created = 0, flushed = 0, written = 0, count = 0;
+	if (!getRecordField(body, record.handle, 8) || !getRecordField(body, record.seq, 8) || !getRecordField(body, created, 8)
+		|| !getRecordField(body, flushed, 8) || !getRecordField(body, written, 8) || !getRecordField(body, count, 4))
+		return false;
+	record.created_ns = static_cast<int64_t>(created);
+	record.flushed_ns = static_cast<int64_t>(flushed);
+	record.written_ns = static_cast<int64_t>(written);
+	record.commands.clear();
+	for (uint64_t i = 0; i < count; ++i) {
+		uint64_t length = 0;
+		if (!getRecordField(body, length, 4) || body.size() < length)
+			return false;
+		record.commands.push_back(body.substr(0, length));
+		body.remove_prefix(length);
+	}
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,224 @@
+/**
+ * @file BlockSink.h
+ * @brief Интерфейс приемника сформированных блоков команд
+ */
+
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @class BlockTracker
+ * @brief Счетчик недоставленных блоков одного процессора.
+ *
+ * Позволяет процессору дождаться записи только своих блоков, не ожидая опустошения
+ * очередей, заполненных другими процессорами. Также учитывает память, занятую
+ * блоками процессора, которые еще не освобождены приемниками, и доставки,
+ * которые приемники не смогли выполнить.
+ */
+class BlockTracker
+{
+public:
+	/**
+	* @brief Учитывает новые доставки
+	* @param count Количество пар (блок, приемник)
+	*/
+	void add(size_t count) {
+		pending_.fetch_add(count, std::memory_order_relaxed);
+	}
+
+	/**
+	* @brief Отмечает доставки как завершенные
+	* @param count Количество пар (блок, приемник)
+	*/
+	void done(size_t count) {
+		if (pending_.fetch_sub(count, std::memory_order_acq_rel) == count) {
+			std::scoped_lock lock(mutex_);
+			cond_.notify_all();
+		}
+	}
+
+	/**
+	* @brief Отмечает доставку, которую приемник не смог выполнить (блок не записан)
+	*/
+	void fail() {
+		failed_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/**
+	* @brief Возвращает количество невыполненных доставок
+	*/
+	size_t failed() const {
+		return failed_.load(std::memory_order_acquire);
+	}
+
+	/**
+	* @brief Ожидает завершения всех учтенных доставок
+	*/
+	void wait_idle() {
+		std::unique_lock lock(mutex_);
+		cond_.wait(lock, [this] { return pending_.load(std::memory_order_acquire) == 0; });
+	}
+
+	/**
+	* @brief Учитывает память отправленного блока
+	*/
+	void hold(size_t bytes) {
+		bytes_.fetch_add(bytes, std::memory_order_relaxed);
+	}
+
+	/**
+	* @brief Освобождает память блока
+	*/
+	void release(size_t bytes) {
+		bytes_.fetch_sub(bytes, std::memory_order_release);
+		bytes_.notify_all();
+	}
+
+	/**
+	* @brief Возвращает память, занятую отправленными и еще не освобожденными блоками
+	*/
+	size_t bytes() const {
+		return bytes_.load(std::memory_order_acquire);
+	}
+
+	/**
+	* @brief Ожидает, пока память отправленных блоков не станет меньше или равной limit
+	*/
+	void wait_bytes(size_t limit) {
+		for (size_t current = bytes(); current > limit; current = bytes())
+			bytes_.wait(current, std::memory_order_acquire);
+	}
+
+private:
+	std::atomic<size_t> pending_{ 0 }; ///< Количество незавершенных доставок
+	std::atomic<size_t> bytes_{ 0 }; ///< Память неосвобожденных блоков
+	std::atomic<size_t> failed_{ 0 }; ///< Количество невыполненных доставок
+	std::mutex mutex_; ///< Мьютекс ожидания
+	std::condition_variable cond_; ///< Сигнал завершения доставок
+};
+
+/**
+ * @struct OutputBlock
+ * @brief Сформированный блок команд, передаваемый в приемники.
+ *
+ * Блок неизменяем после отправки и разделяется между всеми приемниками без копирования.
+ * Память блока (memory) возвращается в счетчик процессора при разрушении блока.
+ */
+struct OutputBlock
+{
+	~OutputBlock() {
+		if (tracker && memory)
+			tracker->release(memory);
+	}
+
+	std::vector<std::string> commands; ///< Команды блока
+	time_t timestamp{ 0 }; ///< Время получения первой команды блока
+	int64_t created_ns{ 0 }; ///< Время получения первой команды блока в наносекундах от эпохи
+	int64_t flushed_ns{ 0 }; ///< Время отправки блока в приемники в наносекундах от эпохи
+	uint64_t handle{ 0 }; ///< Идентификатор процессора, сформировавшего блок
+	uint64_t seq{ 0 }; ///< Порядковый номер блока в пределах процессора, начиная с 0
+	size_t bytes{ 0 }; ///< Суммарный размер команд блока
+	size_t weight{ 1 }; ///< Вес процессора при справедливом распределении записи
+	size_t memory{ 0 }; ///< Память блока, учтенная в tracker
+	std::shared_ptr<BlockTracker> tracker; ///< Счетчик доставок процессора
+};
+
+using BlockPtr = std::shared_ptr<const OutputBlock>; ///< Разделяемый указатель на блок
+
+/**
+ * @class IBlockSink
+ * @brief Интерфейс приемника блоков.
+ *
+ * Приемник регистрируется в MultiThreadOutputter, который выделяет ему собственную
+ * очередь и пул рабочих потоков. Метод write вызывается из рабочих потоков с пачкой блоков;
+ * один и тот же worker никогда не вызывается конкурентно сам с собой.
+ */
+class IBlockSink
+{
+public:
+	virtual ~IBlockSink() = default;
+
+	/**
+	* @brief Имя приемника (для диагностики)
+	*/
+	virtual std::string_view name() const = 0;
+
+	/**
+	* @brief Вызывается один раз до запуска рабочих потоков
+	* @param workers Количество рабочих потоков приемника
+	*/
+	virtual void start(size_t /*workers*/) {}
+
+	/**
+	* @brief Вызывается в рабочем потоке после его привязки к процессорам, до первой записи
+	* @param worker Индекс рабочего потока
+	* @details Буферы потока следует выделять здесь: память окажется на узле NUMA, где работает поток.
+	*/
+	virtual void prepare(size_t /*worker*/) {}
+
+	/**
+	* @brief Записывает пачку блоков
+	* @param blocks Блоки в порядке извлечения из очереди
+	* @param worker Индекс рабочего потока [0, workers)
+	* @details Блок, который не удалось записать, отмечается вызовом failBlock; исключение
+	*          из write отмечает так всю пачку. После возврата из write блоки считаются записанными.
+	*/
+	virtual void write(std::span<const BlockPtr> blocks, size_t worker) = 0;
+
+	/**
+	* @brief Проверяет, остались ли у потока принятые write, но еще не записанные данные
+	* @param worker Индекс рабочего потока
+	* @details Пока метод возвращает true, блоки пачек потока не считаются записанными:
+	*          они подтверждаются после очередного flush.
+	*/
+	virtual bool holds(size_t /*worker*/) const { return false; }
+
+	/**
+	* @brief Дописывает данные, которые рабочий поток накопил между вызовами write
+	* @param worker Индекс рабочего потока
+	* @return false если данные, принятые после предыдущего flush, не удалось записать
+	* @details Вызывается после каждой пачки, на которой holds вернул false, и перед тем как поток,
+	*          у которого остались неподтвержденные блоки, начнет ждать новых.
+	*/
+	virtual bool flush(size_t /*worker*/) { return true; }
+
+	/**
+	* @brief Вызывается после остановки всех рабочих потоков
+	*/
+	virtual void stop() {}
+};
+
+/**
+ * @brief Отмечает блок как не записанный приемником
+ * @param block Блок команд
+ */
+inline void failBlock(const OutputBlock& block)
+{
+	if (block.tracker)
+		block.tracker->fail();
+}
+
+/**
+ * @brief Форматирует блок в строку вида "bulk: cmd1, cmd2\n"
+ * @param out Строка, в конец которой дописывается результат
+ * @param block Блок команд
+ */
+inline void formatBlock(std::string& out, const OutputBlock& block)
+{
+	out += "bulk: ";
+	for (size_t i = 0; i < block.commands.size(); ++i) {
+		if (i > 0)
+			out += ", ";
+		out += block.commands[i];
+	}
+	out += '\n';
+}
\ No newline at end of file
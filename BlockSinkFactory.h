@@ -0,0 +1,111 @@
+#pragma once
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "BlockSinks.h"
+
+/**
+ * @struct SinkSpec
+ * @brief Описание приемника из строки конфигурации.
+ *
+ * Формат строки: "name[:key=value]...[,name...]", например "console,file:threads=2:batch=16".
+ */
+struct SinkSpec
+{
+	std::string name; ///< Имя приемника (console, file, segment, null)
+	std::map<std::string, std::string, std::less<>> params; ///< Параметры приемника и его канала
+
+	/**
+	* @brief Возвращает числовой параметр
+	* @param key Имя параметра
+	* @param fallback Значение по умолчанию
+	*/
+	size_t number(std::string_view key, size_t fallback) const {
+		auto it = params.find(key);
+		if (it == params.end())
+			return fallback;
+		try {
+			return std::stoull(it->second);
+		}
+		catch (const std::exception&) {
+			return fallback;
+		}
+	}
+
+	/**
+	* @brief Возвращает строковый параметр
+	* @param key Имя параметра
+	* @param fallback Значение по умолчанию
+	*/
+	std::string text(std::string_view key, std::string_view fallback) const {
+		auto it = params.find(key);
+		return it == params.end() ? std::string(fallback) : it->second;
+	}
+};
+
+/**
+ * @class BlockSinkFactory
+ * @brief Фабрика для создания приемников блоков.
+ *
+ * Класс BlockSinkFactory разбирает строку конфигурации и создает стандартные приемники по имени.
+ */
+class BlockSinkFactory
+{
+public:
+	/**
+	* @brief Разбирает строку конфигурации приемников.
+	* @param config Строка вида "console,file:threads=2"
+	* @return Список описаний приемников в порядке перечисления
+	*/
+	static std::vector<SinkSpec> parse(std::string_view config) {
+		std::vector<SinkSpec> specs;
+		while (!config.empty()) {
+			size_t comma = config.find(',');
+			std::string_view item = config.substr(0, comma);
+			config = comma == std::string_view::npos ? std::string_view{} : config.substr(comma + 1);
+
+			SinkSpec spec;
+			size_t colon = item.find(':');
+			spec.name = item.substr(0, colon);
+			while (colon != std::string_view::npos) {
+				item = item.substr(colon + 1);
+				colon = item.find(':');
+				std::string_view param = item.substr(0, colon);
+				size_t eq = param.find('=');
+				spec.params[std::string(param.substr(0, eq))] = eq == std::string_view::npos ? "1" : std::string(param.substr(eq + 1));
+			}
+			if (!spec.name.empty())
+				specs.push_back(std::move(spec));
+		}
+		return specs;
+	}
+
+	/**
+	* @brief Создает приемник по описанию.
+	* @param spec Описание приемника.
+	* @return Указатель на созданный приемник или nullptr, если имя не распознано.
+	*/
+	static std::unique_ptr<IBlockSink> create(const SinkSpec& spec) {
+		Durability durability = spec.text("durability", "none") == "group" ? Durability::Group : Durability::None;
+		if (spec.name == "console") {
+			return std::make_unique<ConsoleSink>();
+		}
+		else if (spec.name == "file") {
+			std::string shard = spec.text("shard", "none");
+			return std::make_unique<FileSink>(spec.text("dir", "LOG"),
+				shard == "handle" ? FileSink::Shard::Handle : shard == "time" ? FileSink::Shard::Time : FileSink::Shard::None,
+				spec.number("shards", 256), spec.number("bucket", 60), durability);
+		}
+		else if (spec.name == "segment") {
+			return std::make_unique<SegmentSink>(spec.text("dir", "LOG"), spec.number("max_bytes", 64 << 20), durability,
+				spec.text("compress", "none") == "lz4" ? Compression::Lz4 : Compression::None, spec.number("frame_bytes", 256 << 10),
+				spec.text("format", "text") == "records" ? SegmentSink::Format::Records : SegmentSink::Format::Text);
+		}
+		else if (spec.name == "null") {
+			return std::make_unique<NullSink>();
+		}
+		return nullptr;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,395 @@
+/**
+ * @file BlockSinks.cpp
+ * @brief Реализация стандартных приемников блоков
+ */
+#include "BlockSinks.h"
+#include "BlockRecord.h"
+#include "FastClock.h"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <iostream>
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define BLOCKSINKS_POSIX
+#endif
+
+namespace {
+	/// @brief Сколько файлов пачки FileSink держит открытыми в режиме Durability::Group до промежуточной фиксации
+	constexpr size_t GROUP_OPEN_FILES = 128;
+
+	/// @brief Дописывает число в строку без промежуточных потоков
+	template<typename T>
+	void appendNumber(std::string& out, T value)
+	{
+		char digits[24];
+		auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), value);
+		out.append(digits, end);
+	}
+}
+
+void ConsoleSink::write(std::span<const BlockPtr> blocks, size_t /*worker*/)
+{
+	std::string out;
+	for (const auto& block : blocks)
+		formatBlock(out, *block);
+	std::cout.write(out.data(), static_cast<std::streamsize>(out.size()));
+	std::cout.flush();
+}
+
+FileSink::~FileSink()
+{
+	stop();
+}
+
+bool FileSink::Directory::is_open() const
+{
+#ifdef BLOCKSINKS_POSIX
+	return fd >= 0;
+#else
+	return !path.empty();
+#endif
+}
+
+void FileSink::Directory::close()
+{
+#ifdef BLOCKSINKS_POSIX
+	if (fd >= 0)
+		::close(fd);
+	fd = -1;
+#endif
+	path.clear();
+}
+
+FileSink::Directory FileSink::openDirectory(const Directory& parent, const std::string& name, bool* created)
+{
+	Directory dir;
+#ifdef BLOCKSINKS_POSIX
+	bool made = ::mkdirat(parent.fd, name.c_str(), 0755) == 0;
+	if (created)
+		*created = made;
+	dir.fd = ::openat(parent.fd, name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dir.fd < 0)
+		std::cerr << "Error opening directory: " << parent.path / name << std::endl;
+	else
+		dir.path = parent.path / name;
+#else
+	std::error_code ec;
+	bool made = std::filesystem::create_directories(parent.path / name, ec);
+	if (created)
+		*created = made;
+	if (ec)
+		std::cerr << "Error opening directory: " << parent.path / name << std::endl;
+	else
+		dir.path = parent.path / name;
+#endif
+	return dir;
+}
+
+bool FileSink::writeFile(const Directory& dir, const char* filename, const std::string& data, int* keep)
+{
+#ifdef BLOCKSINKS_POSIX
+	int fd = ::openat(dir.fd, filename, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return false;
+	bool written = ::write(fd, data.data(), data.size()) == static_cast<ssize_t>(data.size());
+	if (keep && written)
+		*keep = fd;
+	else
+		::close(fd);
+	return written;
+#else
+	(void)keep;
+	std::ofstream file(dir.path / filename, std::ios::app | std::ios::binary);
+	file.write(data.data(), static_cast<std::streamsize>(data.size()));
+	return file.good();
+#endif
+}
+
+void FileSink::syncGroup(Worker& state)
+{
+#ifdef BLOCKSINKS_POSIX
+	for (auto& [fd, block] : state.unsynced_files) {
+		if (::fdatasync(fd) != 0) {
+			std::cerr << "Error syncing file of block " << block->handle << "-" << block->seq << std::endl;
+			failBlock(*block);
+			block = nullptr; // Ошибка уже учтена, повторно при сбое каталога не считается
+		}
+		::close(fd);
+	}
+	std::sort(state.unsynced_dirs.begin(), state.unsynced_dirs.end());
+	state.unsynced_dirs.erase(std::unique(state.unsynced_dirs.begin(), state.unsynced_dirs.end()), state.unsynced_dirs.end());
+	bool synced = true;
+	for (int dir : state.unsynced_dirs) {
+		if (::fsync(dir) != 0) {
+			std::cerr << "Error syncing log directory" << std::endl;
+			synced = false;
+		}
+	}
+	if (!synced) { // Записи каталога могут не пережить сбой - блоки группы не считаются записанными
+		for (auto [fd, block] : state.unsynced_files) {
+			if (block)
+				failBlock(*block);
+		}
+	}
+#endif
+	state.unsynced_files.clear();
+	state.unsynced_dirs.clear();
+}
+
+void FileSink::start(size_t workers)
+{
+	std::error_code ec;
+	std::filesystem::create_directories(dir_, ec);
+	Directory parent;
+#ifdef BLOCKSINKS_POSIX
+	parent.fd = AT_FDCWD;
+#endif
+	root_ = openDirectory(parent, dir_.string());
+	workers_.resize(workers);
+	if (shard_ == Shard::Handle) {
+		for (auto& state : workers_)
+			state.shards.resize(shards_);
+	}
+}
+
+void FileSink::prepare(size_t worker)
+{
+	workers_[worker].buffer.reserve(4096);
+	workers_[worker].filename.reserve(128);
+}
+
+const FileSink::Directory& FileSink::directoryFor(Worker& state, const OutputBlock& block)
+{
+	bool group = durability_ == Durability::Group;
+	bool created = false;
+	if (shard_ == Shard::Handle) {
+		size_t index = static_cast<size_t>((block.handle * 0x9E3779B97F4A7C15ull) >> 32) % shards_;
+		Directory& dir = state.shards[index];
+		if (!dir.is_open()) {
+			char name[24];
+			auto [end, ec] = std::to_chars(name, name + sizeof(name), index, 16);
+			dir = openDirectory(root_, std::string(name, end), &created);
+		}
+		if (group && created)
+			state.unsynced_dirs.push_back(root_.fd);
+		return dir;
+	}
+	if (shard_ == Shard::Time) {
+		time_t bucket = block.timestamp - block.timestamp % static_cast<time_t>(bucket_);
+		if (!state.bucket_dir.is_open() || bucket != state.bucket) {
+			if (group && !state.unsynced_dirs.empty())
+				syncGroup(state); // Прежний подкаталог фиксируется, пока его дескриптор открыт
+			state.bucket_dir.close();
+			state.bucket_dir = openDirectory(root_, std::to_string(bucket), &created);
+			state.bucket = bucket;
+		}
+		if (group && created)
+			state.unsynced_dirs.push_back(root_.fd);
+		return state.bucket_dir;
+	}
+	return root_;
+}
+
+void FileSink::write(std::span<const BlockPtr> blocks, size_t worker)
+{
+	Worker& state = workers_[worker];
+	bool group = durability_ == Durability::Group;
+	for (const auto& block : blocks) {
+		const Directory& dir = directoryFor(state, *block);
+		if (!dir.is_open()) {
+			failBlock(*block);
+			continue;
+		}
+
+		// bulk<timestamp>_threadID_<N>_<counter>_<handle>-<seq>_<created_ns>_<flushed_ns>.log
+		state.filename.assign("bulk");
+		appendNumber(state.filename, block->timestamp);
+		state.filename += "_threadID_";
+		appendNumber(state.filename, worker + 1);
+		state.filename += '_';
+		appendNumber(state.filename, state.counter++);
+		state.filename += '_';
+		appendNumber(state.filename, block->handle);
+		state.filename += '-';
+		appendNumber(state.filename, block->seq);
+		state.filename += '_';
+		appendNumber(state.filename, block->created_ns);
+		state.filename += '_';
+		appendNumber(state.filename, block->flushed_ns);
+		state.filename += ".log";
+
+		state.buffer.clear();
+		formatBlock(state.buffer, *block);
+		int fd = -1;
+		bool written = writeFile(dir, state.filename.c_str(), state.buffer, group ? &fd : nullptr);
+		if (!written && group && !state.unsynced_files.empty() && (errno == EMFILE || errno == ENFILE)) {
+			syncGroup(state); // Освобождаем дескрипторы группы и повторяем
+			written = writeFile(dir, state.filename.c_str(), state.buffer, &fd);
+		}
+		if (!written) {
+			std::cerr << "Error writing file: " << dir.path / state.filename << std::endl;
+			failBlock(*block);
+			continue;
+		}
+		if (group) {
+			state.unsynced_dirs.push_back(dir.fd);
+			if (fd >= 0)
+				state.unsynced_files.emplace_back(fd, block.get());
+			if (state.unsynced_files.size() >= GROUP_OPEN_FILES)
+				syncGroup(state);
+		}
+	}
+	if (group)
+		syncGroup(state);
+}
+
+void FileSink::stop()
+{
+	for (auto& state : workers_) {
+		for (auto& dir : state.shards)
+			dir.close();
+		state.bucket_dir.close();
+	}
+	root_.close();
+}
+
+SegmentSink::~SegmentSink()
+{
+	stop();
+}
+
+void SegmentSink::start(size_t workers)
+{
+	segments_.resize(workers);
+}
+
+void SegmentSink::prepare(size_t worker)
+{
+	segments_[worker].buffer.reserve(compression_ == Compression::Lz4 ? frame_bytes_ + (1 << 16) : 1 << 16);
+	if (compression_ == Compression::Lz4)
+		segments_[worker].frame.reserve(lz4Bound(frame_bytes_) + 64);
+}
+
+bool SegmentSink::openNext(Segment& segment, size_t worker)
+{
+	if (segment.file)
+		std::fclose(segment.file);
+	segment.bytes = 0;
+	segment.file = nullptr;
+	std::error_code ec;
+	std::filesystem::create_directories(dir_, ec);
+	std::string prefix = "segment_" + std::to_string(std::time(nullptr)) + "_" + std::to_string(worker + 1) + "_";
+	const char* extension = format_ == Format::Records
+		? (compression_ == Compression::Lz4 ? ".rec.lz4" : ".rec")
+		: (compression_ == Compression::Lz4 ? ".lz4" : ".log");
+	std::filesystem::path filePath;
+	while (!segment.file) { // Сегмент создается заново: перезапуск в ту же секунду не допишет чужой файл
+		filePath = dir_ / (prefix + std::to_string(segment.index++) + extension);
+		segment.file = std::fopen(filePath.string().c_str(), "wbx");
+		if (!segment.file && errno != EEXIST) {
+			std::cerr << "Error opening file: " << filePath << std::endl;
+			return false;
+		}
+	}
+#ifdef BLOCKSINKS_POSIX
+	if (durability_ == Durability::Group) { // Запись о новом сегменте в каталоге должна пережить сбой
+		int dir = ::open(dir_.string().c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (dir >= 0) {
+			::fsync(dir);
+			::close(dir);
+		}
+	}
+#endif
+	return true;
+}
+
+void SegmentSink::write(std::span<const BlockPtr> blocks, size_t worker)
+{
+	Segment& segment = segments_[worker];
+	if (format_ == Format::Records) {
+		int64_t written_ns = fastNowNs();
+		for (const auto& block : blocks)
+			appendBlockRecord(segment.buffer, *block, written_ns);
+	}
+	else {
+		for (const auto& block : blocks)
+			formatBlock(segment.buffer, *block);
+	}
+	if ((compression_ == Compression::None || durability_ == Durability::Group || segment.buffer.size() >= frame_bytes_)
+		&& !writeBuffer(segment, worker)) {
+		for (const auto& block : blocks)
+			failBlock(*block);
+	}
+}
+
+bool SegmentSink::writeBuffer(Segment& segment, size_t worker)
+{
+	if ((!segment.file || segment.bytes >= max_bytes_) && !openNext(segment, worker)) {
+		segment.buffer.clear();
+		segment.lost = true;
+		return false;
+	}
+	if (format_ == Format::Records && segment.bytes == 0) // Новый сегмент начинается с сигнатуры
+		segment.buffer.insert(0, BLOCK_RECORD_MAGIC);
+	std::string_view data = segment.buffer;
+	if (compression_ == Compression::Lz4) {
+		segment.frame.clear();
+		for (size_t pos = 0; pos < segment.buffer.size(); pos += frame_bytes_) // Пачка могла превысить размер блока кадра
+			lz4AppendFrame(std::string_view(segment.buffer).substr(pos, frame_bytes_), segment.frame);
+		data = segment.frame;
+	}
+	size_t written = std::fwrite(data.data(), 1, data.size(), segment.file);
+	segment.bytes += written;
+	segment.buffer.clear();
+	bool ok = written == data.size() && std::fflush(segment.file) == 0;
+#ifdef BLOCKSINKS_POSIX
+	if (durability_ == Durability::Group)
+		ok = ::fdatasync(::fileno(segment.file)) == 0 && ok;
+#endif
+	if (!ok) {
+		std::cerr << "Error writing segment of worker " << worker + 1 << std::endl;
+		segment.lost = true;
+	}
+	return ok;
+}
+
+bool SegmentSink::holds(size_t worker) const
+{
+	return !segments_[worker].buffer.empty();
+}
+
+bool SegmentSink::flush(size_t worker)
+{
+	Segment& segment = segments_[worker];
+	bool written = segment.buffer.empty() || writeBuffer(segment, worker);
+	written = written && !segment.lost;
+	segment.lost = false;
+	return written;
+}
+
+void SegmentSink::stop()
+{
+	for (size_t worker = 0; worker < segments_.size(); ++worker) {
+		Segment& segment = segments_[worker];
+		if (!segment.buffer.empty())
+			writeBuffer(segment, worker);
+		if (segment.file) {
+			std::fclose(segment.file);
+			segment.file = nullptr;
+		}
+	}
+}
+
+void NullSink::write(std::span<const BlockPtr> blocks, size_t /*worker*/)
+{
+	size_t commands = 0;
+	for (const auto& block : blocks)
+		commands += block->commands.size();
+	blocks_.fetch_add(blocks.size(), std::memory_order_relaxed);
+	commands_.fetch_add(commands, std::memory_order_relaxed);
+}
\ No newline at end of file
@@ -0,0 +1,279 @@
+/**
+ * @file BlockSinks.h
+ * @brief Стандартные приемники блоков: консоль, файлы, сегменты и пустой приемник
+ */
+
+#pragma once
+#include "BlockSink.h"
+#include "Lz4.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Уровень надежности записи на диск
+ */
+enum class Durability
+{
+	None, ///< Данные остаются в кэше ОС, сбой системы может их потерять
+	Group ///< Групповая фиксация: один fdatasync на файл за пачку блоков до сигнала о завершении записи
+};
+
+/**
+ * @brief Сжатие записываемых данных
+ */
+enum class Compression
+{
+	None, ///< Без сжатия
+	Lz4 ///< Кадры LZ4 (распаковываются bulk_cat или lz4 -dc)
+};
+
+/**
+ * @class ConsoleSink
+ * @brief Выводит блоки в стандартный поток вывода.
+ *
+ * Пачка блоков форматируется в один буфер и выводится одной операцией записи.
+ */
+class ConsoleSink : public IBlockSink
+{
+public:
+	std::string_view name() const override { return "console"; }
+	void write(std::span<const BlockPtr> blocks, size_t worker) override;
+};
+
+/**
+ * @class FileSink
+ * @brief Записывает каждый блок в отдельный файл каталога логов.
+ *
+ * Имя файла: bulk<timestamp>_threadID_<N>_<counter>_<handle>-<seq>_<created_ns>_<flushed_ns>.log, где N - номер
+ * рабочего потока начиная с 1, counter - счетчик файлов потока, handle и seq - идентификатор процессора и номер
+ * блока в нем, created_ns и flushed_ns - время первой команды и отправки блока в наносекундах.
+ * По паре handle-seq восстанавливается исходный порядок блоков процессора независимо от того,
+ * какой поток их записал.
+ *
+ * Каталог открывается один раз при запуске, файлы создаются относительно его дескриптора (openat).
+ * Чтобы каталог не разрастался до миллионов записей, файлы можно распределять по подкаталогам:
+ * по хэшу процессора (shard=handle, shards подкаталогов с шестнадцатеричными именами)
+ * или по интервалам времени (shard=time, подкаталог на каждые bucket секунд).
+ *
+ * В режиме Durability::Group файлы пачки остаются открытыми до конца write (но не больше
+ * GROUP_OPEN_FILES одновременно), затем для каждого выполняется fdatasync, а для затронутых
+ * каталогов (и каталога логов, если в нем создан подкаталог) - fsync, чтобы записи каталогов
+ * пережили сбой. Блоки, файлы которых не удалось
+ * создать, записать или зафиксировать, отмечаются failBlock.
+ */
+class FileSink : public IBlockSink
+{
+public:
+	/**
+	* @brief Способ распределения файлов по подкаталогам
+	*/
+	enum class Shard
+	{
+		None,   ///< Все файлы в одном каталоге
+		Handle, ///< Подкаталог по хэшу идентификатора процессора
+		Time    ///< Подкаталог на интервал времени
+	};
+
+	/**
+	* @brief Конструктор приемника
+	* @param dir Каталог для файлов логов
+	* @param shard Способ распределения по подкаталогам
+	* @param shards Количество подкаталогов для Shard::Handle
+	* @param bucket Длительность интервала в секундах для Shard::Time
+	* @param durability Уровень надежности записи
+	*/
+	explicit FileSink(std::filesystem::path dir = "LOG", Shard shard = Shard::None, size_t shards = 256, size_t bucket = 60,
+		Durability durability = Durability::None)
+		: dir_(std::move(dir)), shard_(shard), shards_(shards ? shards : 1), bucket_(bucket ? bucket : 1), durability_(durability) {
+	}
+
+	~FileSink() override;
+
+	std::string_view name() const override { return "file"; }
+	void start(size_t workers) override;
+	void prepare(size_t worker) override;
+	void write(std::span<const BlockPtr> blocks, size_t worker) override;
+	void stop() override;
+
+private:
+	/**
+	* @struct Directory
+	* @brief Открытый каталог: дескриптор в POSIX-системах, путь в остальных
+	*/
+	struct Directory
+	{
+		int fd{ -1 }; ///< Дескриптор каталога
+		std::filesystem::path path; ///< Путь к каталогу
+
+		bool is_open() const;
+		void close();
+	};
+
+	/**
+	* @struct Worker
+	* @brief Состояние рабочего потока
+	*/
+	struct Worker
+	{
+		uint64_t counter{ 0 }; ///< Счетчик созданных потоком файлов
+		std::vector<Directory> shards; ///< Подкаталоги Shard::Handle
+		Directory bucket_dir; ///< Подкаталог текущего интервала Shard::Time
+		time_t bucket{ 0 }; ///< Начало текущего интервала
+		std::string buffer; ///< Буфер форматирования блока
+		std::string filename; ///< Буфер имени файла
+		std::vector<std::pair<int, const OutputBlock*>> unsynced_files; ///< Файлы пачки, ожидающие fdatasync, и их блоки
+		std::vector<int> unsynced_dirs; ///< Дескрипторы каталогов пачки, ожидающих fsync
+	};
+
+	/**
+	* @brief Открывает подкаталог, создавая его при необходимости
+	* @param created Если задан, получает true, когда подкаталог был создан этим вызовом
+	*/
+	static Directory openDirectory(const Directory& parent, const std::string& name, bool* created = nullptr);
+
+	/**
+	* @brief Создает файл в каталоге и дописывает в него данные
+	* @param keep Если задан, записанный файл не закрывается, а его дескриптор сохраняется для fdatasync
+	* @return false если файл не удалось создать или записать
+	*/
+	static bool writeFile(const Directory& dir, const char* filename, const std::string& data, int* keep);
+
+	/**
+	* @brief Фиксирует на диске файлы и каталоги пачки
+	*/
+	static void syncGroup(Worker& state);
+
+	/**
+	* @brief Возвращает каталог для блока с учетом распределения по подкаталогам
+	* @details В режиме Durability::Group смена интервала фиксирует группу до закрытия прежнего
+	*          подкаталога, а создание подкаталога добавляет в группу fsync каталога логов.
+	*/
+	const Directory& directoryFor(Worker& state, const OutputBlock& block);
+
+	std::filesystem::path dir_; ///< Каталог для файлов логов
+	Shard shard_; ///< Способ распределения по подкаталогам
+	size_t shards_; ///< Количество подкаталогов Shard::Handle
+	size_t bucket_; ///< Длительность интервала Shard::Time в секундах
+	Durability durability_; ///< Уровень надежности записи
+	Directory root_; ///< Открытый каталог логов
+	std::vector<Worker> workers_; ///< Состояния рабочих потоков
+};
+
+/**
+ * @class SegmentSink
+ * @brief Дописывает блоки в крупные файлы-сегменты.
+ *
+ * Каждый рабочий поток ведет собственный сегмент segment_<timestamp>_<N>_<index>.log
+ * и открывает новый при превышении max_bytes. Сегмент всегда создается новым файлом: если имя занято
+ * (например, после перезапуска в ту же секунду), index увеличивается. Подходит для потоков блоков,
+ * при которых создание файла на каждый блок становится узким местом.
+ * В режиме Durability::Group после записи пачки выполняется один fdatasync сегмента.
+ *
+ * В режиме Compression::Lz4 блоки копятся в группу до frame_bytes и записываются одним кадром LZ4
+ * в segment_<timestamp>_<N>_<index>.lz4: рабочие потоки тратят процессор на сжатие вместо дискового ввода-вывода.
+ * В формате Format::Records вместо строк "bulk: ..." пишутся двоичные записи (BlockRecord.h) со временем
+ * создания, отправки и записи блока в наносекундах; сегменты получают расширение .rec (.rec.lz4 со сжатием).
+ * Неполная группа записывается, прежде чем рабочий поток начнет ждать новых блоков (flush),
+ * а в режиме Durability::Group - после каждой пачки; до этого ее блоки не считаются записанными.
+ * Под нагрузкой кадры заполняются до frame_bytes, при редких блоках становятся короче.
+ */
+class SegmentSink : public IBlockSink
+{
+public:
+	/**
+	* @brief Формат содержимого сегмента
+	*/
+	enum class Format
+	{
+		Text,   ///< Строки "bulk: ..."
+		Records ///< Двоичные записи с временными метками
+	};
+
+	/**
+	* @brief Конструктор приемника
+	* @param dir Каталог для сегментов
+	* @param max_bytes Размер, после которого сегмент закрывается
+	* @param durability Уровень надежности записи
+	* @param compression Сжатие сегментов
+	* @param frame_bytes Объем группы блоков, сжимаемой одним кадром (не больше LZ4_MAX_BLOCK)
+	* @param format Формат содержимого
+	*/
+	explicit SegmentSink(std::filesystem::path dir = "LOG", size_t max_bytes = 64 << 20, Durability durability = Durability::None,
+		Compression compression = Compression::None, size_t frame_bytes = 256 << 10, Format format = Format::Text)
+		: dir_(std::move(dir)), max_bytes_(max_bytes), durability_(durability), compression_(compression),
+		frame_bytes_(std::clamp<size_t>(frame_bytes, 1, LZ4_MAX_BLOCK)), format_(format) {
+	}
+
+	~SegmentSink() override;
+
+	std::string_view name() const override { return "segment"; }
+	void start(size_t workers) override;
+	void prepare(size_t worker) override;
+	void write(std::span<const BlockPtr> blocks, size_t worker) override;
+	bool holds(size_t worker) const override;
+	bool flush(size_t worker) override;
+	void stop() override;
+
+private:
+	/**
+	* @struct Segment
+	* @brief Текущий сегмент рабочего потока
+	*/
+	struct Segment
+	{
+		std::FILE* file{ nullptr }; ///< Открытый файл сегмента
+		size_t bytes{ 0 }; ///< Записано байт в текущий сегмент
+		size_t index{ 0 }; ///< Порядковый номер сегмента
+		std::string buffer; ///< Буфер форматирования пачки
+		std::string frame; ///< Сжатый кадр
+		bool lost{ false }; ///< После предыдущего flush запись не удалась
+	};
+
+	/**
+	* @brief Открывает следующий сегмент рабочего потока
+	*/
+	bool openNext(Segment& segment, size_t worker);
+
+	/**
+	* @brief Записывает накопленные в buffer блоки в сегмент (сжимая их в режиме Lz4)
+	* @return false если сегмент не удалось открыть, записать или зафиксировать
+	*/
+	bool writeBuffer(Segment& segment, size_t worker);
+
+	std::filesystem::path dir_; ///< Каталог для сегментов
+	size_t max_bytes_; ///< Предельный размер сегмента
+	Durability durability_; ///< Уровень надежности записи
+	Compression compression_; ///< Сжатие сегментов
+	size_t frame_bytes_; ///< Объем группы блоков в кадре
+	Format format_; ///< Формат содержимого
+	std::vector<Segment> segments_; ///< Сегменты по рабочим потокам
+};
+
+/**
+ * @class NullSink
+ * @brief Приемник, отбрасывающий блоки.
+ *
+ * Считает принятые блоки и команды; используется для замера пропускной способности конвейера
+ * без затрат на вывод.
+ */
+class NullSink : public IBlockSink
+{
+public:
+	std::string_view name() const override { return "null"; }
+	void write(std::span<const BlockPtr> blocks, size_t worker) override;
+
+	/// @brief Количество принятых блоков
+	size_t blocks() const { return blocks_.load(std::memory_order_relaxed); }
+	/// @brief Количество принятых команд
+	size_t commands() const { return commands_.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<size_t> blocks_{ 0 }; ///< Счетчик блоков
+	std::atomic<size_t> commands_{ 0 }; ///< Счетчик команд
+};
\ No newline at end of file
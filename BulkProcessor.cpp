@@ -1,99 +1,139 @@
 #include "BulkProcessor.h"
-#include "BulkCommandFactory.h"
-#include <chrono>
+#include "BlockJournal.h"
 #include <string>
 #include "MultiThreadOutputter.h"
+#include "Trace.h"
 #include <iostream>
 
-BulkProcessor::BulkProcessor(size_t block_size) : block_size_(block_size)
+template class BasicBulkProcessor<std::mutex, FastClock, OutputterSink>;
+
+namespace {
+	std::atomic<uint64_t> next_processor_id{ 1 };
+
+	/// @brief  :   ,      ,    
+	size_t commandMemory(const std::string& command) {
+		const char* object = reinterpret_cast<const char*>(&command);
+		bool local = command.data() >= object && command.data() < object + sizeof(command);
+		return sizeof(std::string) + (local ? 0 : command.capacity() + 1);
+	}
+
+	/// @brief  ,     command
+	size_t commandMemory(std::string_view command) {
+		static const size_t local_capacity = std::string().capacity();
+		return sizeof(std::string) + (command.size() > local_capacity ? command.size() + 1 : 0);
+	}
+}
+
+OutputterSink::OutputterSink(size_t weight, size_t memory_limit) :
+	id_(next_processor_id.fetch_add(1, std::memory_order_relaxed)),
+	weight_(weight ? weight : 1),
+	memory_limit_(memory_limit),
+	tracker_(std::make_shared<BlockTracker>())
 {
 }
 
-BulkProcessor::~BulkProcessor()
+OutputterSink::~OutputterSink()
 {
 }
 
-void BulkProcessor::startBlock() {
-	std::lock_guard lock(mutex_);
-	if (current_block_.depth == 0)
-		flush();
-	++current_block_.depth;
-	current_block_.is_dynamic = true;
+bool OutputterSink::attach(const std::filesystem::path& path, std::vector<std::string>& commands, size_t& depth, int64_t& created_ns)
+{
+	BlockJournal::State state;
+	bool restored = BlockJournal::load(path, state) && (!state.commands.empty() || state.depth > 0);
+	journal_ = std::make_unique<BlockJournal>(path);
+	journal_->rewrite(state);
+	commands = std::move(state.commands);
+	depth_ = depth = state.depth;
+	size_t bytes = 0;
+	for (const auto& command : commands)
+		bytes += commandMemory(command);
+	open_bytes_.store(bytes, std::memory_order_relaxed);
+	created_ns = state.created_ns;
+	return restored;
 }
 
-void BulkProcessor::endBlock() {
-	std::lock_guard lock(mutex_);
-	if (current_block_.depth > 0) {
-		--current_block_.depth;
-		if (current_block_.depth == 0)
-			flush();
-	}
+void OutputterSink::opened(int64_t created_ns)
+{
+	ASYNC_TRACE(TraceEvent::BlockOpen, nullptr, id_, next_seq_);
+	if (journal_)
+		journal_->open(created_ns);
 }
 
-void BulkProcessor::addCommand(const std::string& command) {
-	std::lock_guard lock(mutex_);
-	if (current_block_.data.empty())
-		current_block_.createTimeStamp = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-	current_block_.data.push_back(command);
-	if (!current_block_.is_dynamic && current_block_.data.size() >= block_size_)
-		flush();
+void OutputterSink::added(std::string_view command)
+{
+	open_bytes_.fetch_add(commandMemory(command), std::memory_order_relaxed);
+	if (journal_)
+		journal_->command(command);
 }
 
-void BulkProcessor::parse(std::string input)
+void OutputterSink::entered()
 {
-	size_t start = 0;
-	size_t pos = 0;
-	while ((pos = input.find("\\n", pos)) != std::string::npos) {
-		input.replace(pos, 2, "\n");
-		pos += 1;
-	}
-	input.erase(0, input.find_first_not_of(" \t"));
-	size_t end = input.find('\n');
-	while (end != std::string::npos) {
-		if (std::string command(input.substr(start, end - start)); !command.empty())
-			process(command);
-		start = end + 1;
-		end = input.find('\n', start);
-	}
-	if (start < input.size()) {
-		std::string command(input.substr(start));
-		if (!command.empty()) {
-			process(command);
-		}
-	}
+	++depth_;
+	if (journal_)
+		journal_->enter();
 }
 
-void BulkProcessor::process(const std::string& command) {
-	auto cmd = BulkCommandFactory::create(command);
-	cmd->execute(*this);
+void OutputterSink::left()
+{
+	--depth_;
+	if (journal_)
+		journal_->leave();
 }
 
-void BulkProcessor::finalize() {
-	if (current_block_.depth == 0)
-		flush();
-	else
-		current_block_.data.clear();
+void OutputterSink::parsed()
+{
+	if (journal_)
+		journal_->commit();
 }
 
-void BulkProcessor::Block::reset()
+void OutputterSink::finalized(size_t depth)
 {
-	//data.clear();
-	std::vector<std::string>().swap(data); //  
-	is_dynamic = false;
-	depth = 0;
-	createTimeStamp = 0;
+	open_bytes_.store(0, std::memory_order_relaxed);
+	if (journal_) { //         
+		if (depth == 0)
+			journal_->remove();
+		else
+			journal_->commit();
+	}
 }
 
-void BulkProcessor::flush() {
-	if (!current_block_.data.empty()) {
-		try {
-			auto& outputter = MultiThreadOutputter::getInstance();
-			outputter.log_queue.push({ current_block_.data, current_block_.createTimeStamp });
-			outputter.file_queue.push({ current_block_.data, current_block_.createTimeStamp });
-		}
-		catch (const std::exception& e) {
-			std::cerr << "Failed to flush block: " << e.what() << std::endl;
-		}
-		current_block_.reset();
+void OutputterSink::write(std::vector<std::string>& commands, int64_t created_ns)
+{
+	try {
+		auto block = std::make_shared<OutputBlock>();
+		block->commands = std::move(commands);
+		block->timestamp = static_cast<time_t>(created_ns / 1000000000);
+		block->created_ns = created_ns;
+		block->flushed_ns = fastNowNs();
+		block->handle = id_;
+		block->seq = next_seq_++;
+		for (const auto& command : block->commands)
+			block->bytes += command.size();
+		block->weight = weight_;
+		block->memory = sizeof(OutputBlock) + block->commands.capacity() * sizeof(std::string);
+		for (const auto& command : block->commands)
+			block->memory += commandMemory(command) - sizeof(std::string);
+		block->tracker = tracker_;
+		tracker_->hold(block->memory);
+		ASYNC_TRACE(TraceEvent::BlockFlush, nullptr, id_, block->seq);
+		MultiThreadOutputter::send(std::move(block));
+	}
+	catch (const std::exception& e) {
+		std::cerr << "Failed to flush block: " << e.what() << std::endl;
 	}
+	open_bytes_.store(0, std::memory_order_relaxed);
+	if (journal_)
+		journal_->flushed(depth_);
+	if (memory_limit_)
+		tracker_->wait_bytes(memory_limit_ / 2); //   :  
+}
+
+bool BulkProcessor::attach(const std::filesystem::path& journal)
+{
+	std::vector<std::string> commands;
+	size_t depth = 0;
+	int64_t created_ns = 0;
+	bool restored = sink().attach(journal, commands, depth, created_ns);
+	restore(std::move(commands), depth, created_ns);
+	return restored;
 }
\ No newline at end of file
@@ -1,86 +1,142 @@
 #pragma once
+#include <cstdint>
+#include <filesystem>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <atomic>
+#include <memory>
 #include <mutex>
+#include "BasicBulkProcessor.h"
+#include "BlockSink.h"
+#include "FastClock.h"
+
+class BlockJournal;
 
 /**
- * @class BulkProcessor
- * @brief Обрабатывает команды и управляет блоками команд.
+ * @class OutputterSink
+ * @brief Политика приемника библиотеки: отправляет блоки в MultiThreadOutputter.
  *
- * Класс BulkProcessor предназначен для обработки команд, группировки их в блоки
- * и выполнения операций над этими блоками, таких как вывод на экран и логирование.
+ * Нумерует блоки процессора, учитывает их в счетчике недоставленных блоков,
+ * ведет журнал открытого блока сессии и записывает события трассировки.
+ *
+ * Бюджет памяти: открытый блок может занимать до половины memory_limit, после чего передается
+ * досрочно; если отправленные блоки процессора занимают больше половины, write ждет,
+ * пока приемники их освободят. Память процессора ограничена memory_limit с точностью до одной команды.
  */
-class BulkProcessor
+class OutputterSink
 {
 public:
 	/**
-	* @brief Конструктор класса BulkProcessor.
-	* @param block_size Размер блока команд.
+	* @brief Конструктор приемника процессора
+	* @param weight Вес процессора при справедливом распределении записи между процессорами
+	* @param memory_limit Бюджет памяти процессора в байтах (0 - без ограничения)
 	*/
-	explicit BulkProcessor(size_t block_size);
+	explicit OutputterSink(size_t weight = 1, size_t memory_limit = 0);
+	~OutputterSink();
 
-	/**
-	* @brief Деструктор класса BulkProcessor.
-	*/
-	~BulkProcessor();
+	OutputterSink(const OutputterSink&) = delete;
+	OutputterSink& operator=(const OutputterSink&) = delete;
+
+	/// @brief Отправляет блок в приемники библиотеки
+	void write(std::vector<std::string>& commands, int64_t created_ns);
+	/// @brief Первая команда нового блока
+	void opened(int64_t created_ns);
+	/// @brief Команда добавлена в блок
+	void added(std::string_view command);
+	/// @brief Вход в динамический блок
+	void entered();
+	/// @brief Выход из динамического блока
+	void left();
+	/// @brief Конец вызова parse: записи журнала передаются в файл
+	void parsed();
+	/// @brief Конец finalize: журнал удаляется, если открытого блока не осталось
+	void finalized(size_t depth);
+	/// @brief Проверяет, превысил ли открытый блок свою часть бюджета памяти
+	bool over_budget() const { return memory_limit_ && open_bytes_.load(std::memory_order_relaxed) > memory_limit_ / 2; }
 
 	/**
-	* @brief Завершает обработку команд и выполняет финализацию.
+	* @brief Возвращает память процессора: открытый блок и отправленные, но не освобожденные блоки
 	*/
-	void finalize();
+	size_t memory() const { return open_bytes_.load(std::memory_order_relaxed) + tracker_->bytes(); }
 
 	/**
-	* @brief Начинает новый динамический блок команд.
+	* @brief Подключает журнал и читает из него открытый блок прежней сессии
+	* @param path Путь к файлу журнала
+	* @param commands Команды восстановленного блока
+	* @param depth Глубина вложенности восстановленного блока
+	* @param created_ns Время создания восстановленного блока
+	* @return true если восстановлен непустой блок или незакрытый динамический блок
 	*/
-	void startBlock();
+	bool attach(const std::filesystem::path& path, std::vector<std::string>& commands, size_t& depth, int64_t& created_ns);
+
+	/// @brief Возвращает уникальный идентификатор процессора
+	uint64_t id() const { return id_; }
+
+	/// @brief Ожидает записи всех отправленных процессором блоков
+	void wait_idle() const { tracker_->wait_idle(); }
+
+	/// @brief Возвращает количество блоков процессора, которые приемники не смогли записать
+	size_t failed() const { return tracker_->failed(); }
+
+private:
+	uint64_t id_; ///< Уникальный идентификатор процессора
+	uint64_t next_seq_{ 0 }; ///< Номер следующего отправляемого блока
+	size_t weight_; ///< Вес процессора
+	size_t memory_limit_; ///< Бюджет памяти процессора
+	std::atomic<size_t> open_bytes_{ 0 }; ///< Память открытого блока
+	size_t depth_{ 0 }; ///< Глубина вложенности открытого блока
+	std::shared_ptr<BlockTracker> tracker_; ///< Счетчик недоставленных блоков процессора
+	std::unique_ptr<BlockJournal> journal_; ///< Журнал открытого блока (если процессор подключен к сессии)
+};
+
+extern template class BasicBulkProcessor<std::mutex, FastClock, OutputterSink>;
 
+/**
+ * @class BulkProcessor
+ * @brief Процессор команд библиотеки: BasicBulkProcessor с мьютексом, часами fastNowNs() и отправкой в MultiThreadOutputter.
+ *
+ * Класс BulkProcessor предназначен для обработки команд, группировки их в блоки
+ * и выполнения операций над этими блоками, таких как вывод на экран и логирование.
+ */
+class BulkProcessor : public BasicBulkProcessor<std::mutex, FastClock, OutputterSink>
+{
+public:
 	/**
-	* @brief Завершает текущий динамический блок команд.
+	* @brief Конструктор класса BulkProcessor.
+	* @param block_size Размер блока команд.
+	* @param weight Вес процессора при справедливом распределении записи между процессорами.
+	* @param memory_limit Бюджет памяти процессора в байтах (0 - без ограничения).
 	*/
-	void endBlock();
+	explicit BulkProcessor(size_t block_size, size_t weight = 1, size_t memory_limit = 0)
+		: BasicBulkProcessor(block_size, weight, memory_limit) {
+	}
 
 	/**
-	* @brief Добавляет команду в текущий блок.
-	* @param command Команда для добавления.
+	* @brief Подключает журнал открытого блока, восстанавливая из него блок прежней сессии
+	* @param journal Путь к файлу журнала сессии
+	* @return true если восстановлен непустой блок или незакрытый динамический блок
+	* @details Вызывается до первого receive. Далее каждое изменение открытого блока записывается
+	*          в журнал, а при finalize незакрытый динамический блок сохраняется в нем вместо отбрасывания.
 	*/
-	void addCommand(const std::string& command);
+	bool attach(const std::filesystem::path& journal);
 
 	/**
-	* @brief Обрабатывает входную строку команд.
-	* @param input Входная строка команд.
+	* @brief Возвращает уникальный идентификатор процессора
 	*/
-	void parse(std::string input);
+	uint64_t id() const { return sink().id(); }
 
-private:
 	/**
-	* @brief Обрабатывает команду.
-	* @param command Команда для обработки.
+	* @brief Ожидает записи всех отправленных процессором блоков
 	*/
-	void process(const std::string& command);
+	void wait_idle() const { sink().wait_idle(); }
+
 	/**
-	* @brief Сбрасывает текущий блок, выводя и логируя его содержимое.
+	* @brief Возвращает количество пар (блок, приемник), которые приемники не смогли записать
 	*/
-	void flush();
+	size_t failed() const { return sink().failed(); }
 
 	/**
-	* @struct Block
-	* @brief Структура, представляющая блок команд.
+	* @brief Возвращает память процессора в байтах: открытый блок и блоки в очередях приемников
 	*/
-	struct Block
-	{
-		/**
-		* @brief Сбрасывает блок, очищая его данные и сбрасывая флаги.
-		*/
-		void reset();
-
-		std::vector<std::string> data; ///< Вектор команд в блоке.
-		bool is_dynamic{ false }; ///< Флаг, указывающий, является ли блок динамическим.
-		size_t depth{ 0 }; ///< Глубина вложенности блоков.
-		time_t createTimeStamp{ 0 }; ///< Время создания блока
-	};
-
-	size_t block_size_; ///< Размер блока команд.
-	Block current_block_; ///< Текущий блок команд.
-	mutable std::mutex mutex_;
+	size_t memory() const { return sink().memory(); }
 };
\ No newline at end of file
@@ -0,0 +1,248 @@
+/**
+ * @file FairQueue.h
+ * @brief Потокобезопасная очередь со справедливым распределением между потоками данных
+ * @tparam T Тип элементов очереди
+ */
+
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <stop_token>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * @class FairQueue
+ * @brief Очередь с подочередями по ключу, обслуживаемыми по алгоритму Deficit Round Robin.
+ *
+ * Каждый ключ (процессор) получает собственную FIFO-подочередь. За один круг подочередь
+ * может выдать элементов суммарной стоимостью до quantum * weight, поэтому всплеск от одного
+ * ключа не задерживает остальные на всю длину своего хвоста. Порядок элементов одного ключа сохраняется.
+ *
+ * Очередь принадлежит одному потоку-владельцу, который извлекает элементы через *_pop_batch
+ * и сообщает о завершении обработки пачки вызовом done(). Другие потоки могут забирать
+ * элементы одного ключа через steal() (не более max за вызов). При краже с сохранением порядка ключ
+ * «одалживается»: владелец пропускает его подочередь до вызова release(), а ключи
+ * обрабатываемой владельцем пачки не крадутся.
+ */
+template<typename T>
+class FairQueue
+{
+	/**
+	* @struct Flow
+	* @brief Подочередь одного ключа
+	*/
+	struct Flow
+	{
+		std::deque<std::pair<T, size_t>> items; ///< Элементы и их стоимость
+		size_t weight{ 1 }; ///< Вес ключа
+		size_t deficit{ 0 }; ///< Неизрасходованный бюджет текущего круга
+		bool in_turn{ false }; ///< Бюджет текущего круга уже начислен
+	};
+
+	std::unordered_map<uint64_t, Flow> flows_; ///< Непустые подочереди
+	std::deque<uint64_t> active_; ///< Порядок обхода непустых подочередей
+	std::unordered_set<uint64_t> busy_; ///< Ключи пачки, обрабатываемой владельцем
+	std::unordered_set<uint64_t> lent_; ///< Ключи, ранние элементы которых обрабатывает другой поток
+	size_t quantum_; ///< Бюджет круга для ключа с весом 1
+	size_t size_{ 0 }; ///< Общее количество элементов
+	size_t available_{ 0 }; ///< Количество элементов в подочередях, доступных владельцу
+	mutable std::mutex mutex_;
+	std::condition_variable_any cond_;
+
+	/**
+	* @brief Удаляет ключ из порядка обхода (вызывается под блокировкой)
+	*/
+	void deactivate(uint64_t key) {
+		for (auto it = active_.begin(); it != active_.end(); ++it) {
+			if (*it == key) {
+				active_.erase(it);
+				return;
+			}
+		}
+	}
+
+	/**
+	* @brief Извлекает до max элементов по кругу DRR (вызывается под блокировкой)
+	*/
+	void pop_locked(std::vector<T>& items, size_t max) {
+		size_t taken = 0;
+		size_t skipped = 0;
+		while (taken < max && skipped < active_.size()) {
+			uint64_t key = active_.front();
+			if (lent_.contains(key)) { // Ранние элементы ключа еще обрабатывает другой поток
+				active_.pop_front();
+				active_.push_back(key);
+				++skipped;
+				continue;
+			}
+			skipped = 0;
+			busy_.insert(key);
+			Flow& flow = flows_[key];
+			if (!flow.in_turn) {
+				flow.deficit += quantum_ * flow.weight;
+				flow.in_turn = true;
+			}
+			while (taken < max && !flow.items.empty() && flow.items.front().second <= flow.deficit) {
+				flow.deficit -= flow.items.front().second;
+				items.push_back(std::move(flow.items.front().first));
+				flow.items.pop_front();
+				--size_;
+				--available_;
+				++taken;
+			}
+			if (flow.items.empty()) {
+				flows_.erase(key);
+				active_.pop_front();
+			}
+			else if (flow.items.front().second > flow.deficit) { // Бюджет круга исчерпан
+				flow.in_turn = false;
+				active_.pop_front();
+				active_.push_back(key);
+			}
+		}
+	}
+
+public:
+	/**
+	* @brief Конструктор очереди
+	* @param quantum Бюджет круга для ключа с весом 1
+	*/
+	explicit FairQueue(size_t quantum = 4096) : quantum_(quantum ? quantum : 1) {}
+
+	/**
+	* @brief Добавляет элемент в подочередь ключа
+	* @param key Ключ подочереди
+	* @param weight Вес ключа (доля обслуживания относительно других ключей)
+	* @param cost Стоимость элемента в единицах quantum
+	* @param item Элемент для добавления
+	*/
+	void push(uint64_t key, size_t weight, size_t cost, T item) {
+		std::scoped_lock lock(mutex_);
+		auto [it, inserted] = flows_.try_emplace(key);
+		if (inserted)
+			active_.push_back(key);
+		it->second.weight = weight ? weight : 1;
+		it->second.items.emplace_back(std::move(item), cost);
+		++size_;
+		if (!lent_.contains(key)) {
+			++available_;
+			cond_.notify_one();
+		}
+	}
+
+	/**
+	* @brief Сообщает, что владелец завершил обработку извлеченной пачки
+	*/
+	void done() {
+		std::scoped_lock lock(mutex_);
+		busy_.clear();
+	}
+
+	/**
+	* @brief Забирает до max элементов одного ключа для обработки другим потоком
+	* @param items Вектор, в конец которого добавляются извлеченные элементы
+	* @param max Максимальное количество извлекаемых элементов
+	* @param ordered Сохранять порядок ключа: не трогать ключи пачки владельца и одолжить ключ до release()
+	* @param key Ключ, элементы которого извлечены
+	* @return true если извлечен хотя бы один элемент
+	*/
+	bool steal(std::vector<T>& items, size_t max, bool ordered, uint64_t& key) {
+		std::scoped_lock lock(mutex_);
+		if (ordered && active_.size() < lent_.size() + 2)
+			return false; // Единственный доступный ключ владельца: кража не добавит параллелизма
+		for (uint64_t candidate : active_) {
+			if (lent_.contains(candidate) || (ordered && busy_.contains(candidate)))
+				continue;
+			Flow& flow = flows_[candidate];
+			size_t taken = 0;
+			for (; taken < max && !flow.items.empty(); ++taken) {
+				items.push_back(std::move(flow.items.front().first));
+				flow.items.pop_front();
+			}
+			size_ -= taken;
+			available_ -= taken;
+			key = candidate;
+			if (ordered) {
+				lent_.insert(candidate);
+				available_ -= flow.items.size();
+			}
+			if (flow.items.empty()) {
+				flows_.erase(candidate);
+				deactivate(candidate);
+			}
+			return taken != 0;
+		}
+		return false;
+	}
+
+	/**
+	* @brief Возвращает одолженный ключ владельцу
+	* @param key Ключ, переданный steal()
+	*/
+	void release(uint64_t key) {
+		std::scoped_lock lock(mutex_);
+		if (lent_.erase(key) == 0)
+			return;
+		if (auto it = flows_.find(key); it != flows_.end() && !it->second.items.empty()) {
+			available_ += it->second.items.size();
+			cond_.notify_one();
+		}
+	}
+
+	/**
+	* @brief Проверяет пустоту очереди
+	*/
+	bool empty() const {
+		std::scoped_lock lock(mutex_);
+		return size_ == 0;
+	}
+
+	/**
+	* @brief Возвращает количество элементов во всех подочередях
+	*/
+	size_t size() const {
+		std::scoped_lock lock(mutex_);
+		return size_;
+	}
+
+	/**
+	* @brief Извлекает до max элементов с ожиданием
+	* @return false если ожидание прервано остановкой и очередь пуста
+	*/
+	bool wait_and_pop_batch(std::vector<T>& items, size_t max, std::stop_token stoken) {
+		std::unique_lock lock(mutex_);
+		if (!cond_.wait(lock, stoken, [this] { return available_ != 0; }))
+			return false;
+		pop_locked(items, max);
+		return true;
+	}
+
+	/**
+	* @brief Извлекает до max элементов, ожидая не дольше заданного момента
+	* @return true если извлечен хотя бы один элемент
+	*/
+	template<typename Clock, typename Duration>
+	bool wait_until_and_pop_batch(std::vector<T>& items, size_t max, const std::chrono::time_point<Clock, Duration>& deadline, std::stop_token stoken) {
+		std::unique_lock lock(mutex_);
+		if (!cond_.wait_until(lock, stoken, deadline, [this] { return available_ != 0; }))
+			return false;
+		pop_locked(items, max);
+		return true;
+	}
+
+	/**
+	* @brief Извлекает до max элементов без ожидания
+	* @return true если извлечен хотя бы один элемент
+	*/
+	bool try_pop_batch(std::vector<T>& items, size_t max) {
+		std::scoped_lock lock(mutex_);
+		if (available_ == 0) return false;
+		pop_locked(items, max);
+		return true;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,151 @@
+/**
+ * @file FastClock.cpp
+ * @brief Реализация часов на счетчике тактов процессора
+ */
+#include "FastClock.h"
+#include <atomic>
+#include <chrono>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <cpuid.h>
+#include <x86intrin.h>
+#define FASTCLOCK_TSC
+#endif
+
+namespace {
+	int64_t systemNs() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+
+#ifdef FASTCLOCK_TSC
+	__extension__ typedef unsigned __int128 uint128; ///< Для умножения без переполнения
+
+	constexpr int64_t CALIBRATION_NS = 200'000'000; ///< Первая калибровка по интервалу 200 мс
+	constexpr int64_t ANCHOR_NS = 1'000'000'000; ///< Повторная привязка к system_clock раз в секунду
+	constexpr uint64_t MAX_BRACKET_TICKS = 20'000; ///< Предельная ширина замера до калибровки (единицы микросекунд)
+	constexpr int64_t MAX_BRACKET_NS = 2'000; ///< Предельная ширина замера после калибровки
+	constexpr int SAMPLE_ATTEMPTS = 8; ///< Попыток получить узкий замер
+	constexpr uint64_t MAX_DRIFT_PPM = 500; ///< Допустимое отклонение новой частоты от прежней, миллионные доли
+	constexpr int MAX_REJECTS = 3; ///< После стольких отклонений подряд новая частота принимается
+
+	bool invariantTsc() {
+		unsigned eax = 0, ebx = 0, ecx = 0, edx = 0;
+		if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx))
+			return false;
+		return edx & (1u << 8);
+	}
+
+	/// @brief Точка привязки счетчика тактов к system_clock, читается по протоколу seqlock
+	struct Anchor
+	{
+		std::atomic<uint64_t> seq{ 0 }; ///< Нечетное значение - запись в процессе
+		std::atomic<uint64_t> tsc{ 0 }; ///< Счетчик тактов в точке привязки
+		std::atomic<int64_t> ns{ 0 }; ///< Системное время в точке привязки
+		std::atomic<uint64_t> mult{ 0 }; ///< Наносекунд на такт, умноженное на 2^32 (0 - не откалиброван)
+		std::atomic<uint64_t> limit{ 0 }; ///< Тактов до следующей привязки
+	};
+
+	/// @brief Одновременные показания счетчика тактов и system_clock
+	struct Sample
+	{
+		uint64_t tsc; ///< Середина интервала между двумя чтениями счетчика
+		int64_t ns; ///< Системное время, прочитанное между ними
+	};
+
+	const bool tsc_supported = invariantTsc();
+	Anchor anchor;
+	std::atomic_flag updating = ATOMIC_FLAG_INIT;
+	int rejects = 0; ///< Отклоненных подряд измерений частоты (изменяется под флагом updating)
+
+	/// @brief Читает system_clock между двумя rdtsc, выбирая самый узкий из нескольких замеров
+	/// @param mult Текущая частота (0 - еще не откалиброван)
+	/// @return false если поток вытесняли во всех попытках и замер неточен
+	bool sample(Sample& out, uint64_t mult) {
+		uint64_t limit = mult ? static_cast<uint64_t>((static_cast<uint128>(MAX_BRACKET_NS) << 32) / mult) : MAX_BRACKET_TICKS;
+		uint64_t best = UINT64_MAX;
+		for (int i = 0; i < SAMPLE_ATTEMPTS && best > limit / 4; ++i) {
+			uint64_t before = __rdtsc();
+			int64_t ns = systemNs();
+			uint64_t after = __rdtsc();
+			if (after >= before && after - before < best) {
+				best = after - before;
+				out = { before + best / 2, ns };
+			}
+		}
+		return best <= limit;
+	}
+
+	/// @brief Привязывает счетчик к system_clock, уточняя частоту по интервалу с прошлой привязки
+	/// @details Частота, отличающаяся от прежней больше чем на MAX_DRIFT_PPM, считается ошибкой
+	///          замера (или скачком system_clock) и принимается только после MAX_REJECTS повторов;
+	///          точка привязки при этом все равно переносится.
+	void reanchor() {
+		if (updating.test_and_set(std::memory_order_acquire))
+			return; // Привязку уже выполняет другой поток
+		uint64_t base_tsc = anchor.tsc.load(std::memory_order_relaxed);
+		int64_t base_ns = anchor.ns.load(std::memory_order_relaxed);
+		uint64_t mult = anchor.mult.load(std::memory_order_relaxed);
+		Sample now{};
+		bool ready = sample(now, mult);
+		if (ready && base_ns != 0) {
+			uint64_t ticks = now.tsc - base_tsc;
+			int64_t elapsed = now.ns - base_ns;
+			if (now.tsc <= base_tsc || elapsed < (mult ? ANCHOR_NS / 2 : CALIBRATION_NS))
+				ready = false; // Интервал слишком короткий для калибровки
+			else {
+				uint64_t measured = static_cast<uint64_t>((static_cast<uint128>(elapsed) << 32) / ticks);
+				uint64_t deviation = mult ? static_cast<uint64_t>(static_cast<uint128>(measured > mult ? measured - mult : mult - measured)
+					* 1'000'000 / mult) : 0;
+				if (deviation <= MAX_DRIFT_PPM || ++rejects > MAX_REJECTS) {
+					mult = measured;
+					rejects = 0;
+				}
+			}
+		}
+		if (ready) {
+			uint64_t seq = anchor.seq.load(std::memory_order_relaxed);
+			anchor.seq.store(seq + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			anchor.tsc.store(now.tsc, std::memory_order_relaxed);
+			anchor.ns.store(now.ns, std::memory_order_relaxed);
+			anchor.mult.store(mult, std::memory_order_relaxed);
+			anchor.limit.store(mult ? static_cast<uint64_t>((static_cast<uint128>(ANCHOR_NS) << 32) / mult) : 0,
+				std::memory_order_relaxed);
+			anchor.seq.store(seq + 2, std::memory_order_release);
+		}
+		updating.clear(std::memory_order_release);
+	}
+#endif
+}
+
+int64_t fastNowNs()
+{
+#ifdef FASTCLOCK_TSC
+	if (!tsc_supported)
+		return systemNs();
+	uint64_t tsc = __rdtsc();
+	uint64_t seq, base_tsc, mult, limit;
+	int64_t base_ns;
+	do {
+		seq = anchor.seq.load(std::memory_order_acquire);
+		base_tsc = anchor.tsc.load(std::memory_order_relaxed);
+		base_ns = anchor.ns.load(std::memory_order_relaxed);
+		mult = anchor.mult.load(std::memory_order_relaxed);
+		limit = anchor.limit.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+	} while ((seq & 1) || anchor.seq.load(std::memory_order_relaxed) != seq);
+	if (mult == 0) { // До калибровки время берется из system_clock
+		int64_t ns = systemNs();
+		if (base_ns == 0 || ns - base_ns >= CALIBRATION_NS)
+			reanchor();
+		return ns;
+	}
+	if (tsc < base_tsc)
+		return base_ns; // Точку привязки перенесли после чтения счетчика
+	if (tsc - base_tsc > limit)
+		reanchor(); // Этот вызов еще использует прежнюю точку привязки
+	return base_ns + static_cast<int64_t>((static_cast<uint128>(tsc - base_tsc) * mult) >> 32);
+#else
+	return systemNs();
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+/**
+ * @file FastClock.h
+ * @brief Дешевые системные часы с наносекундным разрешением
+ */
+
+#pragma once
+#include <cstdint>
+
+/**
+ * @brief Возвращает системное время в наносекундах от эпохи
+ * @details На x86 с инвариантным счетчиком тактов время вычисляется по rdtsc: счетчик
+ *          калибруется по system_clock за первые 200 мс работы и затем раз в секунду
+ *          заново привязывается к system_clock, так что вызов стоит нескольких наносекунд
+ *          и не уходит от системного времени больше чем на десятки микросекунд. Каждая привязка
+ *          читает system_clock между двумя rdtsc и отбрасывает замеры, прерванные вытеснением
+ *          потока. При привязке время может сдвинуться на микросекунды назад. На других
+ *          платформах и до калибровки используется system_clock.
+ */
+int64_t fastNowNs();
+
+/**
+ * @struct FastClock
+ * @brief Политика часов BasicBulkProcessor на основе fastNowNs()
+ */
+struct FastClock
+{
+	int64_t now() const { return fastNowNs(); }
+};
\ No newline at end of file
@@ -0,0 +1,248 @@
+/**
+ * @file Lz4.cpp
+ * @brief Реализация сжатия LZ4
+ */
+#include "Lz4.h"
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace {
+	constexpr uint32_t FRAME_MAGIC = 0x184D2204;
+	constexpr size_t MIN_MATCH = 4;
+	constexpr size_t LAST_LITERALS = 5; ///< Последние байты блока всегда литералы
+	constexpr size_t MF_LIMIT = 12; ///< Совпадение не может начинаться ближе к концу блока
+	constexpr size_t MAX_OFFSET = 65535;
+	constexpr int HASH_LOG = 14;
+
+	uint32_t read32(const char* p) {
+		uint32_t value;
+		std::memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	uint32_t readLE32(const unsigned char* p) {
+		return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+	}
+
+	void appendLE32(std::string& out, uint32_t value) {
+		for (int i = 0; i < 4; ++i)
+			out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+	}
+
+	uint32_t hash(uint32_t sequence) {
+		return (sequence * 2654435761u) >> (32 - HASH_LOG);
+	}
+
+	char* writeLength(char* op, size_t length) {
+		for (; length >= 255; length -= 255)
+			*op++ = static_cast<char>(255);
+		*op++ = static_cast<char>(length);
+		return op;
+	}
+
+	char* writeSequence(char* op, const char* literals, size_t literal_length, size_t offset, size_t match_length) {
+		char* token = op++;
+		size_t match_code = match_length ? match_length - MIN_MATCH : 0;
+		*token = static_cast<char>(((literal_length < 15 ? literal_length : 15) << 4) | (match_code < 15 ? match_code : 15));
+		if (literal_length >= 15)
+			op = writeLength(op, literal_length - 15);
+		std::memcpy(op, literals, literal_length);
+		op += literal_length;
+		if (match_length == 0)
+			return op; // Последняя последовательность содержит только литералы
+		*op++ = static_cast<char>(offset & 0xFF);
+		*op++ = static_cast<char>(offset >> 8);
+		if (match_code >= 15)
+			op = writeLength(op, match_code - 15);
+		return op;
+	}
+
+	uint32_t rotl(uint32_t value, int bits) {
+		return (value << bits) | (value >> (32 - bits));
+	}
+
+	/// @brief XXH32 с нулевым начальным значением для коротких входов (контрольная сумма дескриптора кадра)
+	uint32_t xxh32(const unsigned char* data, size_t size) {
+		constexpr uint32_t P2 = 2246822519u, P3 = 3266489917u, P4 = 668265263u, P5 = 374761393u;
+		uint32_t h = P5 + static_cast<uint32_t>(size);
+		size_t i = 0;
+		for (; i + 4 <= size; i += 4)
+			h = rotl(h + readLE32(data + i) * P3, 17) * P4;
+		for (; i < size; ++i)
+			h = rotl(h + data[i] * P5, 11) * 2654435761u;
+		h ^= h >> 15;
+		h *= P2;
+		h ^= h >> 13;
+		h *= P3;
+		h ^= h >> 16;
+		return h;
+	}
+}
+
+size_t lz4Compress(const char* src, size_t size, char* dst)
+{
+	char* op = dst;
+	size_t anchor = 0;
+	if (size >= MF_LIMIT + 1) {
+		std::vector<int32_t> table(size_t{ 1 } << HASH_LOG, -1);
+		const size_t match_limit = size - LAST_LITERALS;
+		const size_t last_start = size - MF_LIMIT; // Последняя позиция, с которой может начинаться совпадение
+		size_t ip = 0;
+		while (ip <= last_start) {
+			uint32_t sequence = read32(src + ip);
+			uint32_t h = hash(sequence);
+			int32_t candidate = table[h];
+			table[h] = static_cast<int32_t>(ip);
+			if (candidate < 0 || ip - candidate > MAX_OFFSET || read32(src + candidate) != sequence) {
+				ip += 1 + ((ip - anchor) >> 6); // Ускоряемся на несжимаемых участках
+				continue;
+			}
+			size_t ref = static_cast<size_t>(candidate);
+			while (ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1]) {
+				--ip;
+				--ref;
+			}
+			size_t length = MIN_MATCH;
+			while (ip + length < match_limit && src[ip + length] == src[ref + length])
+				++length;
+			op = writeSequence(op, src + anchor, ip - anchor, ip - ref, length);
+			ip += length;
+			anchor = ip;
+			if (ip <= last_start)
+				table[hash(read32(src + ip - 2))] = static_cast<int32_t>(ip - 2);
+		}
+	}
+	return static_cast<size_t>(writeSequence(op, src + anchor, size - anchor, 0, 0) - dst);
+}
+
+bool lz4Decompress(const char* src, size_t size, std::string& out, size_t max_size)
+{
+	const auto* ip = reinterpret_cast<const unsigned char*>(src);
+	const auto* end = ip + size;
+	const size_t limit = out.size() + max_size;
+	auto readLength = [&](size_t& length) {
+		unsigned char byte;
+		do {
+			if (ip == end)
+				return false;
+			byte = *ip++;
+			length += byte;
+		} while (byte == 255);
+		return true;
+	};
+	while (ip < end) {
+		unsigned char token = *ip++;
+		size_t literal_length = token >> 4;
+		if (literal_length == 15 && !readLength(literal_length))
+			return false;
+		if (static_cast<size_t>(end - ip) < literal_length || out.size() + literal_length > limit)
+			return false;
+		out.append(reinterpret_cast<const char*>(ip), literal_length);
+		ip += literal_length;
+		if (ip == end)
+			return true;
+		if (end - ip < 2)
+			return false;
+		size_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		size_t match_length = token & 15;
+		if (match_length == 15 && !readLength(match_length))
+			return false;
+		match_length += MIN_MATCH;
+		if (offset == 0 || offset > out.size() || out.size() + match_length > limit)
+			return false;
+		size_t from = out.size() - offset;
+		if (offset >= match_length)
+			out.append(out, from, match_length);
+		else {
+			for (size_t i = 0; i < match_length; ++i)
+				out.push_back(out[from + i]); // Перекрывающееся совпадение повторяет последние offset байт
+		}
+	}
+	return size == 0;
+}
+
+void lz4AppendFrame(std::string_view data, std::string& out)
+{
+	const unsigned char descriptor[2] = { 0x60, 0x70 }; // Версия 1, независимые блоки; блоки до 4 МиБ
+	appendLE32(out, FRAME_MAGIC);
+	out.push_back(static_cast<char>(descriptor[0]));
+	out.push_back(static_cast<char>(descriptor[1]));
+	out.push_back(static_cast<char>((xxh32(descriptor, 2) >> 8) & 0xFF));
+	if (!data.empty()) {
+		size_t header = out.size();
+		out.resize(header + 4 + lz4Bound(data.size()));
+		size_t compressed = lz4Compress(data.data(), data.size(), out.data() + header + 4);
+		if (compressed < data.size()) {
+			out.resize(header + 4 + compressed);
+			for (int i = 0; i < 4; ++i)
+				out[header + i] = static_cast<char>((compressed >> (8 * i)) & 0xFF);
+		}
+		else {
+			out.resize(header);
+			appendLE32(out, static_cast<uint32_t>(data.size()) | 0x80000000u); // Блок без сжатия
+			out.append(data);
+		}
+	}
+	appendLE32(out, 0); // Конец кадра
+}
+
+bool lz4IsFrame(std::string_view data)
+{
+	return data.size() >= 4 && readLE32(reinterpret_cast<const unsigned char*>(data.data())) == FRAME_MAGIC;
+}
+
+bool lz4ReadFrames(std::string_view data, std::string& out)
+{
+	const auto* ip = reinterpret_cast<const unsigned char*>(data.data());
+	const auto* end = ip + data.size();
+	while (ip < end) {
+		if (end - ip < 4)
+			return false;
+		uint32_t magic = readLE32(ip);
+		ip += 4;
+		if ((magic & 0xFFFFFFF0u) == 0x184D2A50u) { // Пропускаемый кадр
+			if (end - ip < 4 || static_cast<size_t>(end - ip - 4) < readLE32(ip))
+				return false;
+			ip += 4 + readLE32(ip);
+			continue;
+		}
+		if (magic != FRAME_MAGIC || end - ip < 3)
+			return false;
+		unsigned char flags = ip[0];
+		unsigned char block_descriptor = ip[1];
+		if ((flags >> 6) != 1 || (flags & 0x01)) // Версия формата и словари
+			return false;
+		bool block_checksum = flags & 0x10;
+		bool content_size = flags & 0x08;
+		bool content_checksum = flags & 0x04;
+		size_t max_block = size_t{ 1 } << (8 + 2 * ((block_descriptor >> 4) & 0x07));
+		size_t header = 2 + (content_size ? 8 : 0);
+		if (static_cast<size_t>(end - ip) < header + 1 || ((xxh32(ip, header) >> 8) & 0xFF) != ip[header])
+			return false;
+		ip += header + 1;
+		while (true) {
+			if (end - ip < 4)
+				return false;
+			uint32_t block = readLE32(ip);
+			ip += 4;
+			if (block == 0)
+				break;
+			size_t block_size = block & 0x7FFFFFFFu;
+			if (block_size > max_block || static_cast<size_t>(end - ip) < block_size + (block_checksum ? 4 : 0))
+				return false;
+			if (block & 0x80000000u)
+				out.append(reinterpret_cast<const char*>(ip), block_size);
+			else if (!lz4Decompress(reinterpret_cast<const char*>(ip), block_size, out, max_block))
+				return false;
+			ip += block_size + (block_checksum ? 4 : 0);
+		}
+		if (content_checksum) {
+			if (end - ip < 4)
+				return false;
+			ip += 4;
+		}
+	}
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+/**
+ * @file Lz4.h
+ * @brief Сжатие в формате LZ4 (блоки и кадры), не требующее внешних библиотек
+ *
+ * Кадры совместимы с утилитой lz4: файл из склеенных кадров распаковывается командой lz4 -dc.
+ */
+
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/// @brief Наибольший размер блока LZ4 в кадре (4 МиБ)
+constexpr size_t LZ4_MAX_BLOCK = 4 << 20;
+
+/**
+ * @brief Возвращает наибольший размер сжатого блока для входа заданного размера
+ */
+constexpr size_t lz4Bound(size_t size) { return size + size / 255 + 16; }
+
+/**
+ * @brief Сжимает данные в блок LZ4
+ * @param src Исходные данные
+ * @param size Размер исходных данных
+ * @param dst Буфер размером не меньше lz4Bound(size)
+ * @return Размер сжатого блока
+ */
+size_t lz4Compress(const char* src, size_t size, char* dst);
+
+/**
+ * @brief Распаковывает блок LZ4, дописывая результат в out
+ * @param src Сжатый блок
+ * @param size Размер сжатого блока
+ * @param out Приемник; ссылки блока могут указывать на ранее распакованные в out данные
+ * @param max_size Наибольший допустимый размер распакованного блока
+ * @return false если блок поврежден
+ */
+bool lz4Decompress(const char* src, size_t size, std::string& out, size_t max_size);
+
+/**
+ * @brief Дописывает в out кадр LZ4 с одним блоком, содержащим data
+ * @param data Данные размером не больше LZ4_MAX_BLOCK
+ * @param out Приемник кадра
+ * @details Если сжатие не уменьшает размер, блок сохраняется без сжатия.
+ */
+void lz4AppendFrame(std::string_view data, std::string& out);
+
+/**
+ * @brief Проверяет, начинаются ли данные с заголовка кадра LZ4
+ */
+bool lz4IsFrame(std::string_view data);
+
+/**
+ * @brief Распаковывает последовательность склеенных кадров LZ4
+ * @param data Кадры
+ * @param out Приемник распакованных данных
+ * @return false если данные повреждены или используют неподдерживаемые возможности формата
+ */
+bool lz4ReadFrames(std::string_view data, std::string& out);
\ No newline at end of file
@@ -3,95 +3,328 @@
  * @brief Реализация класса MultiThreadOutputter
  */
 #include "MultiThreadOutputter.h"
-#include <iostream>
-#include <filesystem>
-#include <fstream>
-#include <random>
+#include "BlockSinkFactory.h"
+#include "ThreadPlacement.h"
+#include "Trace.h"
+#include <algorithm>
 #include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
 #include <thread>
 #include <stop_token>
 
 MultiThreadOutputter::~MultiThreadOutputter()
 {
-	stop_source_.request_stop(); // Посылаем сигнал остановки
+	for (auto& channel : channels_) {
+		for (auto& worker : channel->workers)
+			worker.request_stop(); // Посылаем сигнал остановки
+		for (auto& worker : channel->workers)
+			worker.join();
+		std::vector<BlockPtr> batch; // Остатки, которые потоки не дописали из-за одолженных ключей
+		for (size_t i = 0; i < channel->queues.size(); ++i) {
+			while (channel->queues[i]->try_pop_batch(batch, channel->options.batch))
+				deliver(*channel, batch, i % channel->options.threads);
+		}
+		for (size_t id = 0; id < channel->held.size(); ++id)
+			release(*channel, id);
+		channel->sink->stop();
+	}
+	if (!trace_path_.empty() && !Tracer::dump(trace_path_))
+		std::cerr << "Failed to write trace: " << trace_path_ << std::endl;
 }
 
-MultiThreadOutputter& MultiThreadOutputter::getInstance() {
-	static MultiThreadOutputter instance;
-	return instance;
+namespace {
+	std::shared_mutex instance_mutex; // Разделяемо - на время send/report, монопольно - при замене экземпляра
+	std::unique_ptr<MultiThreadOutputter> instance; // Разрушается при завершении программы, дописывая очереди
+	async::Config last_config; // Параметры последнего init, с которыми экземпляр создается заново
 }
 
-MultiThreadOutputter::MultiThreadOutputter() :
-	log_thread(&MultiThreadOutputter::log_worker, this, stop_source_.get_token()),
-	file_thread1(&MultiThreadOutputter::file_worker, this, 1, stop_source_.get_token()),
-	file_thread2(&MultiThreadOutputter::file_worker, this, 2, stop_source_.get_token())
+void MultiThreadOutputter::send(BlockPtr block)
 {
+	{
+		std::shared_lock lock(instance_mutex);
+		if (instance) {
+			instance->push(std::move(block));
+			return;
+		}
+	}
+	std::scoped_lock lock(instance_mutex);
+	if (!instance)
+		instance.reset(new MultiThreadOutputter(last_config));
+	instance->push(std::move(block));
 }
 
-void MultiThreadOutputter::log_worker(std::stop_token stoken) {
-	ITEM item;
-	while (!stoken.stop_requested()) {
-		if (log_queue.try_pop(item))
-			process_log_item(item);
-		else
-			std::this_thread::yield();
+std::string MultiThreadOutputter::report()
+{
+	std::shared_lock lock(instance_mutex);
+	return instance ? instance->placement() : std::string{};
+}
+
+void MultiThreadOutputter::init(const async::Config& config)
+{
+	std::scoped_lock lock(instance_mutex);
+	last_config = config;
+	instance.reset();
+	instance.reset(new MultiThreadOutputter(config));
+}
+
+void MultiThreadOutputter::shutdown()
+{
+	std::scoped_lock lock(instance_mutex);
+	instance.reset();
+}
+
+MultiThreadOutputter::MultiThreadOutputter(const async::Config& config) : inline_mode_(config.inline_mode)
+{
+	if (const char* inline_mode = std::getenv("ASYNC_INLINE"))
+		inline_mode_ = inline_mode_ || std::string_view(inline_mode) != "0";
+	const char* trace = std::getenv("ASYNC_TRACE");
+	trace_path_ = trace && *trace ? trace : config.trace;
+	if (!trace_path_.empty())
+		Tracer::enable(true);
+	const char* sinks = std::getenv("ASYNC_SINKS");
+	if (!config.sinks.empty())
+		configure(config.sinks);
+	else
+		configure(sinks ? sinks : "console,file:threads=2");
+}
+
+void MultiThreadOutputter::addSink(std::unique_ptr<IBlockSink> sink, SinkOptions options)
+{
+	if (!sink)
+		return;
+	auto channel = std::make_unique<Channel>();
+	channel->sink = std::move(sink);
+	channel->options = options;
+	channel->label = Tracer::intern(channel->sink->name());
+	channel->options.threads = std::max<size_t>(options.threads, 1);
+	channel->options.batch = std::max<size_t>(options.batch, 1);
+	channel->options.steal = options.steal && channel->options.threads > 1 && !inline_mode_;
+	size_t queues = channel->options.ordered || channel->options.steal ? channel->options.threads : 1;
+	for (size_t i = 0; i < queues; ++i)
+		channel->queues.push_back(std::make_unique<FairQueue<BlockPtr>>(options.quantum));
+	if (inline_mode_)
+		channel->options.threads = 1;
+	channel->held.resize(channel->options.threads);
+	channel->sink->start(channel->options.threads);
+	for (size_t id = 0; id < channel->options.threads; ++id) {
+		auto& stats = channel->stats.emplace_back();
+		if (!channel->options.cpus.empty())
+			stats.cpus = { channel->options.cpus[id % channel->options.cpus.size()] };
+		else if (!channel->options.nodes.empty())
+			stats.cpus = nodeCpus(channel->options.nodes[id % channel->options.nodes.size()]);
 	}
-	while (log_queue.try_pop(item))
-		process_log_item(item);
+	for (size_t id = 0; id < channel->options.threads && !inline_mode_; ++id)
+		channel->workers.emplace_back([this, &ch = *channel, id](std::stop_token stoken) { worker(ch, id, stoken); });
+
+	std::unique_lock lock(channels_mutex_);
+	channels_.push_back(std::move(channel));
 }
 
-void MultiThreadOutputter::process_log_item(const ITEM& item) const
+void MultiThreadOutputter::configure(std::string_view config)
 {
-	auto& [commands, timestamp] = item;
+	for (const auto& spec : BlockSinkFactory::parse(config)) {
+		auto sink = BlockSinkFactory::create(spec);
+		if (!sink) {
+			std::cerr << "Unknown sink: " << spec.name << std::endl;
+			continue;
+		}
+		SinkOptions options;
+		options.threads = spec.number("threads", 1);
+		options.window_us = spec.number("window_us", 0);
+		options.window_bytes = spec.number("window_bytes", 0);
+		options.batch = spec.number("batch", options.window_us ? 4096 : 1);
+		options.ordered = spec.number("ordered", 0) != 0;
+		options.quantum = spec.number("quantum", 4096);
+		options.steal = spec.number("steal", 0) != 0;
+		options.steal_us = spec.number("steal_us", 1000);
+		options.cpus = parseCpuList(spec.text("cpus", ""));
+		options.nodes = parseCpuList(spec.text("nodes", ""));
+		addSink(std::move(sink), options);
+	}
+}
+
+void MultiThreadOutputter::push(BlockPtr block)
+{
+	std::shared_lock lock(channels_mutex_);
+	if (inline_mode_) {
+		for (auto& channel : channels_) {
+			std::scoped_lock inline_lock(channel->inline_mutex);
+			write(*channel, { &block, 1 }, 0);
+			if (!flush(*channel, 0))
+				failBlock(*block);
+		}
+		return;
+	}
+	if (block->tracker)
+		block->tracker->add(channels_.size());
+	for (auto& channel : channels_) {
+		ASYNC_TRACE(TraceEvent::Enqueue, channel->label, block->handle, block->seq);
+		channel->queues[block->handle % channel->queues.size()]->push(block->handle, block->weight, block->bytes + 1, block);
+	}
+}
 
-	std::cout << "bulk: ";
-	for (size_t i = 0; i < commands.size(); ++i) {
-		std::cout << commands[i];
-		if (i < commands.size() - 1)
-			std::cout << ", ";
+std::string MultiThreadOutputter::placement() const
+{
+	std::ostringstream out;
+	std::shared_lock lock(channels_mutex_);
+	for (const auto& channel : channels_) {
+		for (size_t id = 0; id < channel->stats.size(); ++id) {
+			const auto& stats = channel->stats[id];
+			out << channel->sink->name() << "#" << id + 1 << " cpus=";
+			if (stats.cpus.empty())
+				out << "any";
+			for (size_t i = 0; i < stats.cpus.size(); ++i)
+				out << (i ? "+" : "") << stats.cpus[i];
+			out << " cpu=" << stats.cpu.load(std::memory_order_relaxed)
+				<< " blocks=" << stats.blocks.load(std::memory_order_relaxed)
+				<< " batches=" << stats.batches.load(std::memory_order_relaxed)
+				<< " migrations=" << stats.migrations.load(std::memory_order_relaxed) << "\n";
+		}
 	}
-	std::cout << std::endl;
+	return out.str();
 }
 
-void MultiThreadOutputter::process_file_item(int id, const ITEM& item, std::mt19937& gen, std::uniform_int_distribution<>& dis) const
+void MultiThreadOutputter::write(Channel& channel, std::span<const BlockPtr> batch, size_t id)
 {
-	auto& [commands, timestamp] = item;
+	ASYNC_TRACE(TraceEvent::WriteBegin, channel.label, batch.size(), 0);
+	try {
+		channel.sink->write(batch, id);
+	}
+	catch (const std::exception& e) {
+		std::cerr << "Sink " << channel.sink->name() << " failed: " << e.what() << std::endl;
+		for (const auto& block : batch)
+			failBlock(*block);
+	}
+	ASYNC_TRACE(TraceEvent::WriteEnd, channel.label, 0, 0);
+}
 
-	std::filesystem::path logDir = "LOG";
-	if (!std::filesystem::exists(logDir)) {
-		std::filesystem::create_directory(logDir);
+void MultiThreadOutputter::deliver(Channel& channel, std::vector<BlockPtr>& batch, size_t id)
+{
+	auto& stats = channel.stats[id];
+	int cpu = currentCpu();
+	if (int previous = stats.cpu.exchange(cpu, std::memory_order_relaxed); previous != -1 && previous != cpu)
+		stats.migrations.fetch_add(1, std::memory_order_relaxed);
+	stats.blocks.fetch_add(batch.size(), std::memory_order_relaxed);
+	stats.batches.fetch_add(1, std::memory_order_relaxed);
+	for (const auto& block : batch)
+		ASYNC_TRACE(TraceEvent::Dequeue, channel.label, block->handle, block->seq);
+	write(channel, batch, id);
+	auto& held = channel.held[id];
+	if (channel.sink->holds(id)) { // Данные пачки еще в буфере приемника - подтверждение откладывается
+		held.insert(held.end(), std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+		batch.clear();
+		return;
 	}
-	std::stringstream filename;
-	filename << "bulk" << timestamp << "_threadID_" << id << "_" << dis(gen) << ".log";
-	std::filesystem::path filePath = logDir / filename.str();
-	std::ofstream file;
-	file.rdbuf()->pubsetbuf(nullptr, 0); // Отключаем буферизацию
-	file.open(filePath, std::ios::app);
-	if (!file.is_open()) {
-		std::cerr << "Error opening file: " << filePath << std::endl;
+	bool written = flush(channel, id); // Буфер записан вместе с пачкой: отложенные блоки тоже на месте
+	for (const auto& block : held) {
+		if (!written)
+			failBlock(*block);
+		if (block->tracker)
+			block->tracker->done(1);
+	}
+	for (const auto& block : batch) {
+		if (block->tracker)
+			block->tracker->done(1);
+	}
+	held.clear();
+	batch.clear();
+}
+
+void MultiThreadOutputter::release(Channel& channel, size_t id)
+{
+	auto& held = channel.held[id];
+	if (held.empty())
 		return;
+	bool written = flush(channel, id);
+	for (const auto& block : held) {
+		if (!written)
+			failBlock(*block);
+		if (block->tracker)
+			block->tracker->done(1);
 	}
-	file << "bulk: ";
-	for (size_t i = 0; i < commands.size(); ++i) {
-		file << commands[i];
-		if (i < commands.size() - 1)
-			file << ", ";
+	held.clear();
+}
+
+bool MultiThreadOutputter::flush(Channel& channel, size_t id)
+{
+	try {
+		return channel.sink->flush(id);
+	}
+	catch (const std::exception& e) {
+		std::cerr << "Sink " << channel.sink->name() << " failed: " << e.what() << std::endl;
+		return false;
+	}
+}
+
+void MultiThreadOutputter::fill_window(Channel& channel, FairQueue<BlockPtr>& queue, std::vector<BlockPtr>& batch, std::stop_token stoken)
+{
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(channel.options.window_us);
+	size_t bytes = 0;
+	size_t counted = 0;
+	while (batch.size() < channel.options.batch) {
+		for (; counted < batch.size(); ++counted)
+			bytes += batch[counted]->bytes;
+		if (channel.options.window_bytes && bytes >= channel.options.window_bytes)
+			break;
+		if (!queue.wait_until_and_pop_batch(batch, channel.options.batch - batch.size(), deadline, stoken))
+			break;
 	}
-	file << std::endl;
 }
 
-void MultiThreadOutputter::file_worker(int id, std::stop_token stoken) {
-	std::random_device rd;
-	std::mt19937 gen(rd());
-	std::uniform_int_distribution dis(100000000, 999999999);
-	ITEM item;
+void MultiThreadOutputter::worker(Channel& channel, size_t id, std::stop_token stoken) {
+	if (!channel.stats[id].cpus.empty() && !pinCurrentThread(channel.stats[id].cpus))
+		std::cerr << "Failed to pin " << channel.sink->name() << " worker " << id + 1 << std::endl;
+	channel.sink->prepare(id);
+	Tracer::nameThread(std::string(channel.sink->name()) + "#" + std::to_string(id + 1));
+
+	auto& queue = *channel.queues[id % channel.queues.size()];
+	std::vector<BlockPtr> batch;
+	batch.reserve(channel.options.batch);
 	while (!stoken.stop_requested()) {
-		if (file_queue.try_pop(item)) {
-			process_file_item(id, item, gen, dis);
+		bool popped = false;
+		if (!channel.held[id].empty()) { // Прежде чем ждать, дописываем буфер приемника и подтверждаем его блоки
+			popped = queue.try_pop_batch(batch, channel.options.batch);
+			if (!popped)
+				release(channel, id);
+		}
+		if (!popped) {
+			popped = channel.options.steal
+				? queue.wait_until_and_pop_batch(batch, channel.options.batch,
+					std::chrono::steady_clock::now() + std::chrono::microseconds(channel.options.steal_us), stoken)
+				: queue.wait_and_pop_batch(batch, channel.options.batch, stoken);
+		}
+		if (popped) {
+			if (channel.options.window_us)
+				fill_window(channel, queue, batch, stoken);
+			deliver(channel, batch, id);
+			queue.done();
+		}
+		else if (channel.options.steal) { // Крадем, пока находится что украсть, а своя очередь пуста
+			while (steal(channel, id, batch) && queue.empty() && !stoken.stop_requested()) {
+			}
+		}
+	}
+	while (queue.try_pop_batch(batch, channel.options.batch)) {
+		deliver(channel, batch, id);
+		queue.done();
+	}
+	release(channel, id);
+}
+
+bool MultiThreadOutputter::steal(Channel& channel, size_t id, std::vector<BlockPtr>& batch)
+{
+	size_t count = channel.queues.size();
+	for (size_t i = 1; i < count; ++i) {
+		auto& victim = *channel.queues[(id + i) % count];
+		uint64_t key = 0;
+		if (victim.steal(batch, channel.options.batch, channel.options.ordered, key)) {
+			deliver(channel, batch, id);
+			if (channel.options.ordered)
+				victim.release(key);
+			return true;
 		}
-		else
-			std::this_thread::yield();
 	}
-	while (file_queue.try_pop(item))
-		process_file_item(id, item, gen, dis);
+	return false;
 }
\ No newline at end of file
@@ -1,49 +1,197 @@
 #pragma once
-#include "ThreadSafeQueue.h"
+#include "FairQueue.h"
+#include "BlockSink.h"
+#include "async.h"
+#include <atomic>
+#include <deque>
+#include <memory>
 #include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <stop_token>
-#include <random>
+#include <vector>
 
-class MultiThreadOutputter
+/**
+ * @struct SinkOptions
+ * @brief Параметры канала доставки блоков в приемник
+ */
+struct SinkOptions
 {
-	using ITEM = std::pair<std::vector<std::string>, time_t>;
+	size_t threads{ 1 }; ///< Количество рабочих потоков приемника
+	size_t batch{ 1 }; ///< Максимальное количество блоков, передаваемых в write за один вызов
+	bool ordered{ false }; ///< Сохранять порядок блоков процессора: все блоки одного процессора обрабатывает один поток
+	size_t window_us{ 0 }; ///< Сколько микросекунд добирать блоки в пачку после первого (групповая фиксация)
+	size_t window_bytes{ 0 }; ///< Объем команд, по достижении которого пачка передается сразу (0 - без ограничения)
+	size_t quantum{ 4096 }; ///< Объем команд, выдаваемый процессору с весом 1 за круг справедливого распределения
+	bool steal{ false }; ///< Очередь у каждого потока, простаивающие потоки забирают у загруженных до batch блоков одного процессора
+	size_t steal_us{ 1000 }; ///< Как долго поток ждет блоков в своей очереди перед попыткой кражи
+	std::vector<int> cpus; ///< Процессоры: поток i закрепляется за cpus[i % cpus.size()]
+	std::vector<int> nodes; ///< Узлы NUMA: поток i закрепляется за процессорами узла nodes[i % nodes.size()]
+};
 
+/**
+ * @class MultiThreadOutputter
+ * @brief Доставляет сформированные блоки в зарегистрированные приемники.
+ *
+ * Каждый приемник получает собственную очередь и пул рабочих потоков. В режиме ordered
+ * у каждого потока своя очередь, а блоки распределяются по идентификатору процессора,
+ * поэтому блоки одного процессора записываются строго по порядку, а разные процессоры
+ * по-прежнему обрабатываются параллельно. Внутри очереди у каждого процессора своя подочередь,
+ * которые обслуживаются по кругу (Deficit Round Robin) с учетом весов процессоров, поэтому
+ * всплеск блоков одного процессора не задерживает вывод остальных.
+ *
+ * В режиме steal у каждого потока своя очередь (блоки распределяются по идентификатору
+ * процессора), а простаивающий поток забирает у другого до batch блоков из подочереди одного
+ * процессора и продолжает красть без ожидания, пока в своей очереди нет блоков, а у других есть.
+ * Вместе с ordered украденный процессор временно закрепляется за укравшим потоком,
+ * так что порядок записи его блоков сохраняется.
+ *
+ * Рабочие потоки можно закрепить за процессорами (cpus) или узлами NUMA (nodes), чтобы
+ * планировщик не переносил их между ядрами; report() показывает фактическое размещение. Набор приемников
+ * по умолчанию задается переменной окружения ASYNC_SINKS (формат см. BlockSinkFactory),
+ * при ее отсутствии используется "console,file:threads=2".
+ *
+ * Экземпляр создается явно через init() либо лениво при первом send() с параметрами
+ * последнего init(). Наружу экземпляр не выдается: send() и report() работают с ним под
+ * разделяемой блокировкой, поэтому init() и shutdown() дожидаются их завершения.
+ * Уничтожение экземпляра (shutdown() или завершение программы) дожидается записи всех
+ * поставленных в очереди блоков. В режиме inline рабочие потоки не создаются, и блоки
+ * записываются синхронно в потоке, вызвавшем push().
+ */
+class MultiThreadOutputter
+{
 public:
 	MultiThreadOutputter(const MultiThreadOutputter&) = delete;
 	MultiThreadOutputter& operator=(const MultiThreadOutputter&) = delete;
 
 	~MultiThreadOutputter();
 
-	static MultiThreadOutputter& getInstance();
+	/**
+	* @brief Отправляет блок текущему экземпляру, при необходимости создавая его
+	* @details Экземпляр создается с параметрами последнего init (по умолчанию, если init не вызывался),
+	*          в том числе когда блок отправлен уже после shutdown.
+	* @param block Сформированный блок
+	*/
+	static void send(BlockPtr block);
+
+	/**
+	* @brief Возвращает сводку по рабочим потокам текущего экземпляра, не создавая его
+	* @return Пустая строка, если библиотека не запущена или остановлена shutdown
+	*/
+	static std::string report();
 
-	ThreadSafeQueue<ITEM> log_queue; ///< Очередь логирования
-	ThreadSafeQueue<ITEM> file_queue; ///< Очередь записи в файл
+	/**
+	* @brief Создает экземпляр с заданными параметрами, завершив предыдущий
+	* @param config Параметры библиотеки
+	*/
+	static void init(const async::Config& config);
+
+	/**
+	* @brief Дожидается записи всех блоков и уничтожает текущий экземпляр
+	*/
+	static void shutdown();
+
+	/**
+	* @brief Регистрирует приемник и запускает его рабочие потоки
+	* @param sink Приемник блоков
+	* @param options Параметры канала доставки
+	*/
+	void addSink(std::unique_ptr<IBlockSink> sink, SinkOptions options = {});
+
+	/**
+	* @brief Регистрирует приемники по строке конфигурации
+	* @param config Строка вида "console,file:threads=2:batch=16"
+	*/
+	void configure(std::string_view config);
+
+	/**
+	* @brief Отправляет блок во все зарегистрированные приемники
+	* @param block Сформированный блок
+	*/
+	void push(BlockPtr block);
 
 private:
-	MultiThreadOutputter();
+	explicit MultiThreadOutputter(const async::Config& config);
 
-	std::jthread log_thread; ///< Поток логирования
-	std::jthread file_thread1; ///< Поток записи в файл 1
-	std::jthread file_thread2; ///< Поток записи в файл 2
-	std::stop_source stop_source_; // Источник сигнала остановки
+	/**
+	* @brief Возвращает сводку по рабочим потокам: привязка, процессор, записанные блоки и миграции
+	*/
+	std::string placement() const;
+
+	/**
+	* @struct WorkerStats
+	* @brief Счетчики рабочего потока
+	*/
+	struct WorkerStats
+	{
+		std::vector<int> cpus; ///< Процессоры, за которыми закреплен поток (пусто - без привязки)
+		std::atomic<int> cpu{ -1 }; ///< Процессор, на котором поток записывал последнюю пачку
+		std::atomic<size_t> blocks{ 0 }; ///< Записано блоков
+		std::atomic<size_t> batches{ 0 }; ///< Записано пачек
+		std::atomic<size_t> migrations{ 0 }; ///< Смены процессора между пачками
+	};
+
+	/**
+	* @struct Channel
+	* @brief Приемник вместе с его очередью и рабочими потоками
+	*/
+	struct Channel
+	{
+		std::unique_ptr<IBlockSink> sink; ///< Приемник
+		SinkOptions options; ///< Параметры канала
+		std::vector<std::unique_ptr<FairQueue<BlockPtr>>> queues; ///< Общая очередь либо очереди потоков в режиме ordered
+		std::deque<WorkerStats> stats; ///< Счетчики рабочих потоков
+		const char* label{ nullptr }; ///< Имя приемника в трассировке
+		std::vector<std::vector<BlockPtr>> held; ///< Записанные, но не подтвержденные блоки потоков (IBlockSink::holds)
+		std::vector<std::jthread> workers; ///< Рабочие потоки приемника
+		std::mutex inline_mutex; ///< Сериализует вызовы write в режиме inline
+	};
+
+	/**
+	* @brief Рабочая функция потока приемника
+	* @param channel Канал, из очереди которого извлекаются блоки
+	* @param id Индекс потока в канале (передается в IBlockSink::write)
+	*/
+	void worker(Channel& channel, size_t id, std::stop_token stoken);
+
+	/**
+	* @brief Забирает и записывает до batch блоков одного процессора из очереди другого потока
+	* @return true если удалось что-то украсть
+	*/
+	bool steal(Channel& channel, size_t id, std::vector<BlockPtr>& batch);
+
+	/**
+	* @brief Добирает блоки в пачку в течение окна window_us или до объема window_bytes
+	*/
+	static void fill_window(Channel& channel, FairQueue<BlockPtr>& queue, std::vector<BlockPtr>& batch, std::stop_token stoken);
+
+	/**
+	* @brief Передает пачку в приемник и отмечает блоки как обработанные
+	* @details Если приемник еще держит данные потока в буфере, блоки откладываются в held
+	*          и подтверждаются вместе со следующей записанной пачкой либо в release.
+	*/
+	void deliver(Channel& channel, std::vector<BlockPtr>& batch, size_t id);
+
+	/**
+	* @brief Дописывает буфер приемника и подтверждает отложенные блоки потока
+	*/
+	static void release(Channel& channel, size_t id);
 
 	/**
-	* @brief Рабочая функция потока логирования
-	*
-	* Обрабатывает команды из очереди и выводит их в консоль
+	* @brief Вызывает IBlockSink::flush, перехватывая исключения
+	* @return false если данные не удалось записать
 	*/
-	void log_worker(std::stop_token stoken);
+	static bool flush(Channel& channel, size_t id);
 
 	/**
-	* @brief Рабочая функция потока записи в файл
-	* @param id Идентификатор потока (используется в имени файла)
-	*
-	* Обрабатывает команды из очереди и записывает их в файл
+	* @brief Передает пачку в приемник, перехватывая исключения
 	*/
-	void file_worker(int id, std::stop_token stoken);
+	static void write(Channel& channel, std::span<const BlockPtr> batch, size_t id);
 
-	void process_log_item(const ITEM& item) const;
-	void process_file_item(int id, const ITEM& item, std::mt19937& gen, std::uniform_int_distribution<>& dis) const;
+	bool inline_mode_; ///< Синхронная запись без рабочих потоков
+	std::string trace_path_; ///< Файл, в который выгружается трассировка при остановке
+	std::vector<std::unique_ptr<Channel>> channels_; ///< Зарегистрированные каналы
+	mutable std::shared_mutex channels_mutex_; ///< Защищает список каналов
 };
\ No newline at end of file
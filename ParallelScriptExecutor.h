@@ -0,0 +1,108 @@
+#pragma once
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "async.h"
+#include "ProcessorCommands.h"
+#include "ProcessorManager.h"
+#include "ThreadSafeQueue.h"
+
+/// @brief Сценарий, разбитый по процессорам
+/// @details Ключ - ID процессора, значение - строки connect/receive/disconnect этого процессора в исходном порядке
+using ScriptPartitions = std::map<int, std::vector<std::string>>;
+
+/// @brief Разбивает сценарий на независимые части по ID процессоров
+/// @param input Входной поток с командами
+/// @return Части сценария по ID процессоров
+/// @details ID назначаются командам connect в порядке следования, как при последовательном выполнении.
+///          Команды для отсутствующих в этот момент процессоров отбрасываются, list и help в неинтерактивном
+///          режиме ничего не делают, разбор прекращается на команде exit.
+inline ScriptPartitions partition_script(std::istream& input)
+{
+	ScriptPartitions partitions;
+	std::unordered_set<int> connected;
+	int next_id = 1;
+
+	std::string line;
+	while (getline(input, line)) {
+		std::istringstream iss(line);
+		std::string cmd;
+		iss >> cmd;
+		if (cmd == "connect") {
+			if (size_t packSize; iss >> packSize) {
+				connected.insert(next_id);
+				partitions[next_id++].push_back(std::move(line));
+			}
+		}
+		else if (cmd == "receive" || cmd == "disconnect") {
+			int id;
+			if (iss >> id && connected.contains(id)) {
+				if (cmd == "disconnect")
+					connected.erase(id);
+				partitions[id].push_back(std::move(line));
+			}
+		}
+		else if (cmd == "exit")
+			break;
+	}
+	return partitions;
+}
+
+/// @brief Выполняет часть сценария одного процессора
+/// @param manager Менеджер процессоров, общий для всех частей
+/// @param id ID процессора, назначенный при разбиении
+/// @param lines Строки сценария этого процессора
+inline void execute_partition(ProcessorManager& manager, int id, const std::vector<std::string>& lines)
+{
+	for (const auto& line : lines) {
+		std::istringstream iss(line);
+		std::string cmd;
+		iss >> cmd;
+		if (cmd == "connect") {
+			size_t packSize = 0;
+			iss >> packSize;
+			manager.addProcessor(async::connect(packSize), id);
+		}
+		else if (cmd == "receive")
+			ReceiveCommand(manager, iss, false).execute();
+		else if (cmd == "disconnect")
+			DisconnectCommand(manager, iss, false).execute();
+	}
+	if (async::HANDLE handle = manager.getProcessor(id)) {
+		async::disconnect(handle);
+		manager.removeProcessor(id);
+	}
+}
+
+/// @brief Обрабатывает команды из входного потока параллельно
+/// @param input Входной поток с командами
+/// @param workers Количество рабочих потоков (0 - по числу ядер)
+/// @details Команды разных процессоров независимы, поэтому сценарий разбивается по ID процессоров,
+///          и части выполняются пулом потоков. Порядок команд каждого процессора и назначенные ID
+///          совпадают с последовательным выполнением process_commands_from_stream.
+inline void process_commands_parallel(std::istream& input, size_t workers = 0)
+{
+	if (workers == 0)
+		workers = std::max(1u, std::thread::hardware_concurrency());
+
+	ScriptPartitions partitions = partition_script(input);
+	ThreadSafeQueue<std::pair<int, const std::vector<std::string>*>> tasks;
+	for (const auto& [id, lines] : partitions)
+		tasks.push({ id, &lines });
+
+	ProcessorManager manager;
+	std::vector<std::jthread> pool;
+	for (size_t i = 0; i < std::min(workers, partitions.size()); ++i) {
+		pool.emplace_back([&manager, &tasks] {
+			std::pair<int, const std::vector<std::string>*> task;
+			while (tasks.try_pop(task))
+				execute_partition(manager, task.first, *task.second);
+			});
+	}
+}
\ No newline at end of file
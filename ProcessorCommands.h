@@ -88,14 +88,9 @@ public:
 	void execute() override {
 		int id;
 		if (std::string data; iss >> id && getline(iss, data)) {
-			size_t pos = 0;
 			async::HANDLE target = manager.getProcessor(id);
 			if (target && !data.empty()) {
-				while ((pos = data.find("\\n", pos)) != std::string::npos) {
-					data.replace(pos, 2, "\n");
-					pos += 1;
-				}
-				data.erase(0, data.find_first_not_of(" \t"));
+				// Последовательности "\\n" и ведущие пробелы обрабатывает библиотека
 				async::receive(target, data.data(), data.size());
 			}
 			else
@@ -117,14 +112,8 @@ public:
 	/// где DATA - данные для обработки
 	void execute() override {
 		std::string data = iss.str();
-		size_t pos = 0;
 		async::HANDLE target = manager.getFirstProcessor();
 		if (target && !data.empty()) {
-			while ((pos = data.find("\\n", pos)) != std::string::npos) {
-				data.replace(pos, 2, "\n");
-				pos += 1;
-			}
-			data.erase(0, data.find_first_not_of(" \t"));
 			async::receive(target, data.data(), data.size());
 		}
 		else {
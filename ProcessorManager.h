@@ -1,5 +1,6 @@
 #pragma once
 #include "async.h"
+#include <algorithm>
 #include <unordered_map>
 #include <mutex>
 #include <atomic>
@@ -14,6 +15,7 @@ class ProcessorManager
 {
 private:
 	std::unordered_map<async::HANDLE, int> processors;  ///< Хранилище процессоров (хэндл → ID)
+	std::unordered_map<int, async::HANDLE> handles;     ///< Обратный индекс (ID → хэндл)
 	int next_id = 1;                                    ///< Счетчик для генерации ID
 	std::atomic<bool> closeRequest_{ false };           ///< Флаг запроса на завершение
 	mutable std::mutex mutex_;                           ///< Мьютекс для синхронизации доступа
@@ -28,10 +30,26 @@ public:
 	int addProcessor(async::HANDLE handle)
 	{
 		std::lock_guard lock(mutex_);
+		handles[next_id] = handle;
 		processors[handle] = next_id++;
 		return next_id - 1;
 	}
 
+	/**
+	 * @brief Добавляет процессор с заранее назначенным ID
+	 * @param handle Хэндл процессора для добавления
+	 * @param id ID процессора
+	 * @note Потокобезопасный метод. Используется при параллельном выполнении сценария,
+	 *       когда ID назначаются заранее в порядке следования команд connect.
+	 */
+	void addProcessor(async::HANDLE handle, int id)
+	{
+		std::lock_guard lock(mutex_);
+		handles[id] = handle;
+		processors[handle] = id;
+		next_id = std::max(next_id, id + 1);
+	}
+
 	/**
 	 * @brief Удаляет процессор по его ID
 	 * @param id ID процессора для удаления
@@ -41,13 +59,12 @@ public:
 	bool removeProcessor(int id)
 	{
 		std::lock_guard lock(mutex_);
-		for (auto it = processors.begin(); it != processors.end(); ++it) {
-			if (it->second == id) {
-				processors.erase(it);
-				return true;
-			}
-		}
-		return false;
+		auto it = handles.find(id);
+		if (it == handles.end())
+			return false;
+		processors.erase(it->second);
+		handles.erase(it);
+		return true;
 	}
 
 	/**
@@ -59,11 +76,8 @@ public:
 	async::HANDLE getProcessor(int id) const
 	{
 		std::lock_guard lock(mutex_);
-		for (const auto& [h, i] : processors) {
-			if (i == id)
-				return h;
-		}
-		return nullptr;
+		auto it = handles.find(id);
+		return it == handles.end() ? nullptr : it->second;
 	}
 
 	/**
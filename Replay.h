@@ -0,0 +1,166 @@
+/**
+ * @file Replay.h
+ * @brief Быстрое воспроизведение потока команд из файла или стандартного ввода
+ *
+ * Вход передается в библиотеку крупными порциями, каждая из которых заканчивается
+ * переводом строки, поэтому команды не разрываются между вызовами async::receive.
+ */
+
+#pragma once
+#include "async.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define REPLAY_HAS_MMAP
+#endif
+
+/// @brief Размер порции, передаваемой в async::receive за один вызов
+constexpr size_t REPLAY_CHUNK_SIZE = 4 << 20;
+
+/// @brief Статистика воспроизведения
+struct ReplayStats
+{
+	size_t bytes{ 0 };   ///< Передано байт
+	size_t lines{ 0 };   ///< Передано строк
+	size_t chunks{ 0 };  ///< Количество вызовов async::receive
+	double seconds{ 0 }; ///< Время воспроизведения вместе с дозаписью блоков
+};
+
+/// @brief Передает порцию данных процессору и учитывает ее в статистике
+/// @param handle Процессор
+/// @param data Начало порции
+/// @param size Размер порции
+/// @param stats Статистика воспроизведения
+inline void replay_send(async::HANDLE handle, const char* data, size_t size, ReplayStats& stats)
+{
+	if (size == 0)
+		return;
+	async::receive(handle, data, size);
+	stats.bytes += size;
+	stats.lines += static_cast<size_t>(std::count(data, data + size, '\n'));
+	++stats.chunks;
+}
+
+/// @brief Возвращает длину префикса, заканчивающегося последним переводом строки
+/// @return 0 если перевода строки нет
+inline size_t replay_complete_lines(const char* data, size_t size)
+{
+	std::string_view view(data, size);
+	size_t pos = view.rfind('\n');
+	return pos == std::string_view::npos ? 0 : pos + 1;
+}
+
+/// @brief Воспроизводит поток, читая его крупными блоками
+/// @param input Открытый поток
+/// @param handle Процессор
+/// @param stats Статистика воспроизведения
+inline void replay_stream(std::FILE* input, async::HANDLE handle, ReplayStats& stats)
+{
+	std::vector<char> buffer(REPLAY_CHUNK_SIZE);
+	size_t filled = 0;
+	while (true) {
+		if (filled == buffer.size())
+			buffer.resize(buffer.size() * 2); // Строка длиннее буфера
+		size_t read = std::fread(buffer.data() + filled, 1, buffer.size() - filled, input);
+		if (read == 0)
+			break;
+		filled += read;
+		size_t complete = replay_complete_lines(buffer.data(), filled);
+		replay_send(handle, buffer.data(), complete, stats);
+		std::memmove(buffer.data(), buffer.data() + complete, filled - complete);
+		filled -= complete;
+	}
+	replay_send(handle, buffer.data(), filled, stats);
+}
+
+#ifdef REPLAY_HAS_MMAP
+/// @brief Воспроизводит файл, отображая его в память
+/// @param path Путь к файлу
+/// @param handle Процессор
+/// @param stats Статистика воспроизведения
+/// @return false если файл не удалось открыть или отобразить
+inline bool replay_mapped(const char* path, async::HANDLE handle, ReplayStats& stats)
+{
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st {};
+	if (::fstat(fd, &st) != 0) {
+		::close(fd);
+		return false;
+	}
+	size_t size = static_cast<size_t>(st.st_size);
+	if (size == 0) {
+		::close(fd);
+		return true;
+	}
+	void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (mapped == MAP_FAILED)
+		return false;
+	::madvise(mapped, size, MADV_SEQUENTIAL);
+
+	const char* data = static_cast<const char*>(mapped);
+	size_t pos = 0;
+	while (pos < size) {
+		size_t end = std::min(pos + REPLAY_CHUNK_SIZE, size);
+		if (end < size) {
+			size_t complete = replay_complete_lines(data + pos, end - pos);
+			if (complete == 0) { // Строка длиннее порции - передаем ее целиком
+				const void* newline = std::memchr(data + end, '\n', size - end);
+				end = newline ? static_cast<size_t>(static_cast<const char*>(newline) - data) + 1 : size;
+			}
+			else
+				end = pos + complete;
+		}
+		replay_send(handle, data + pos, end - pos, stats);
+		pos = end;
+	}
+	::munmap(mapped, size);
+	return true;
+}
+#endif
+
+/// @brief Воспроизводит файл или стандартный ввод
+/// @param path Путь к файлу или "-" для стандартного ввода
+/// @param handle Процессор
+/// @param stats Статистика воспроизведения
+/// @return false если файл не удалось открыть
+inline bool replay(const char* path, async::HANDLE handle, ReplayStats& stats)
+{
+	if (std::string_view(path) == "-") {
+		replay_stream(stdin, handle, stats);
+		return true;
+	}
+#ifdef REPLAY_HAS_MMAP
+	if (replay_mapped(path, handle, stats))
+		return true;
+#endif
+	std::FILE* input = std::fopen(path, "rb");
+	if (!input)
+		return false;
+	replay_stream(input, handle, stats);
+	std::fclose(input);
+	return true;
+}
+
+/// @brief Выводит статистику воспроизведения
+/// @param out Поток вывода
+/// @param stats Статистика воспроизведения
+inline void print_replay_stats(std::ostream& out, const ReplayStats& stats)
+{
+	double mib = static_cast<double>(stats.bytes) / (1 << 20);
+	double seconds = std::max(stats.seconds, 1e-9);
+	out << "replayed " << mib << " MiB, " << stats.lines << " lines in " << stats.chunks << " chunks, "
+		<< stats.seconds << " s: " << mib / seconds << " MiB/s, "
+		<< static_cast<double>(stats.lines) / seconds << " lines/s\n";
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+/**
+ * @file ThreadPlacement.cpp
+ * @brief Реализация привязки рабочих потоков к процессорам и узлам NUMA
+ */
+#include "ThreadPlacement.h"
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <string>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+#ifdef __linux__
+	constexpr int MAX_CPU = CPU_SETSIZE - 1; ///< Наибольший номер, помещающийся в cpu_set_t
+#else
+	constexpr int MAX_CPU = 1023;
+#endif
+}
+
+std::vector<int> parseCpuList(std::string_view list)
+{
+	std::vector<int> cpus;
+	while (!list.empty()) {
+		size_t separator = list.find_first_of(",+");
+		std::string_view item = list.substr(0, separator);
+		list = separator == std::string_view::npos ? std::string_view{} : list.substr(separator + 1);
+
+		int first = 0;
+		int last = 0;
+		auto [end, ec] = std::from_chars(item.data(), item.data() + item.size(), first);
+		if (ec != std::errc())
+			continue;
+		last = first;
+		if (end != item.data() + item.size() && *end == '-')
+			std::from_chars(end + 1, item.data() + item.size(), last);
+		if (first < 0 || first > MAX_CPU || last < first)
+			continue;
+		last = std::min(last, MAX_CPU);
+		for (int cpu = first; cpu <= last; ++cpu)
+			cpus.push_back(cpu);
+	}
+	return cpus;
+}
+
+std::vector<int> nodeCpus(int node)
+{
+#ifdef __linux__
+	std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+	std::string list;
+	if (std::getline(file, list))
+		return parseCpuList(list);
+#else
+	(void)node;
+#endif
+	return {};
+}
+
+bool pinCurrentThread(const std::vector<int>& cpus)
+{
+#ifdef __linux__
+	if (cpus.empty())
+		return false;
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (int cpu : cpus) {
+		if (cpu >= 0 && cpu < CPU_SETSIZE)
+			CPU_SET(cpu, &set);
+	}
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+	(void)cpus;
+	return false;
+#endif
+}
+
+int currentCpu()
+{
+#ifdef __linux__
+	return sched_getcpu();
+#else
+	return -1;
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+/**
+ * @file ThreadPlacement.h
+ * @brief Привязка рабочих потоков к процессорам и узлам NUMA
+ */
+
+#pragma once
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Разбирает список процессоров вида "0-3,8" или "0-3+8"
+ * @param list Список номеров и диапазонов, разделенных ',' или '+'
+ * @return Номера процессоров в порядке перечисления; отрицательные номера и обратные
+ *         диапазоны пропускаются, конец диапазона ограничивается CPU_SETSIZE - 1
+ */
+std::vector<int> parseCpuList(std::string_view list);
+
+/**
+ * @brief Возвращает процессоры узла NUMA
+ * @param node Номер узла
+ * @return Номера процессоров узла; пустой вектор, если узел неизвестен или платформа не Linux
+ */
+std::vector<int> nodeCpus(int node);
+
+/**
+ * @brief Привязывает текущий поток к набору процессоров
+ * @param cpus Номера процессоров
+ * @return true если привязка выполнена
+ */
+bool pinCurrentThread(const std::vector<int>& cpus);
+
+/**
+ * @brief Возвращает процессор, на котором выполняется текущий поток
+ * @return Номер процессора или -1, если платформа не позволяет его узнать
+ */
+int currentCpu();
\ No newline at end of file
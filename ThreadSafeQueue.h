@@ -8,13 +8,15 @@
 #include <queue>
 #include <mutex>
 #include <condition_variable>
+#include <stop_token>
+#include <vector>
 
 template<typename T>
 class ThreadSafeQueue
 {
 	std::queue<T> queue_;
 	mutable std::mutex mutex_;
-	std::condition_variable cond_;
+	std::condition_variable_any cond_;
 
 public:
 	/**
@@ -47,6 +49,24 @@ public:
 		queue_.pop();
 	}
 
+	/**
+	* @brief Извлекает до max элементов с ожиданием
+	* @param items Вектор, в конец которого добавляются извлеченные элементы
+	* @param max Максимальное количество извлекаемых элементов
+	* @param stoken Токен остановки, прерывающий ожидание
+	* @return false если ожидание прервано остановкой и очередь пуста
+	*/
+	bool wait_and_pop_batch(std::vector<T>& items, size_t max, std::stop_token stoken) {
+		std::unique_lock lock(mutex_);
+		if (!cond_.wait(lock, stoken, [this] { return !queue_.empty(); }))
+			return false;
+		for (size_t i = 0; i < max && !queue_.empty(); ++i) {
+			items.push_back(std::move(queue_.front()));
+			queue_.pop();
+		}
+		return true;
+	}
+
 	bool try_pop(T& item) {
 		std::scoped_lock lock(mutex_);
 		if (queue_.empty()) return false;
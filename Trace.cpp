@@ -0,0 +1,227 @@
+/**
+ * @file Trace.cpp
+ * @brief Реализация трассировки в формате Chrome Trace
+ */
+#include "Trace.h"
+#include "FastClock.h"
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+namespace {
+	constexpr size_t RING_CAPACITY = 1 << 16; ///< Событий в буфере одного потока
+	constexpr size_t MAX_DEAD_RINGS = 16; ///< Буферов завершившихся потоков, хранимых до выгрузки
+
+	struct Record
+	{
+		int64_t ns; ///< Момент события
+		uint64_t a;
+		uint64_t b;
+		const char* label;
+		TraceEvent event;
+	};
+
+	/// @brief Кольцевой буфер событий одного потока
+	struct Ring
+	{
+		std::mutex mutex; ///< Захватывается владельцем на запись и выгрузкой на чтение, конкуренции почти нет
+		std::vector<Record> records;
+		size_t next{ 0 }; ///< Всего записано событий
+		size_t tid{ 0 };
+		std::string name;
+		std::atomic<bool> dead{ false }; ///< Поток-владелец завершился; буфер удаляется после выгрузки
+	};
+
+	/// @brief Буферы всех потоков; не разрушается, чтобы выгрузка при завершении программы была безопасна
+	struct Registry
+	{
+		std::mutex mutex;
+		std::vector<std::shared_ptr<Ring>> rings;
+		std::set<std::string, std::less<>> labels;
+		size_t next_tid{ 1 };
+	};
+
+	Registry& registry() {
+		static Registry* instance = new Registry;
+		return *instance;
+	}
+
+	/// @brief Буфер текущего потока; при завершении потока помечает его завершившимся
+	struct ThreadRing
+	{
+		std::shared_ptr<Ring> ring;
+
+		~ThreadRing() {
+			if (ring)
+				ring->dead.store(true, std::memory_order_release);
+		}
+	};
+
+	thread_local ThreadRing thread_ring;
+	thread_local std::string thread_name;
+
+	/// @brief Возвращает буфер текущего потока, при необходимости создавая его
+	/// @details Если без выгрузки накопилось MAX_DEAD_RINGS буферов завершившихся потоков,
+	///          старейший из них очищается и переходит к новому потоку.
+	Ring& ring() {
+		if (!thread_ring.ring) {
+			auto& reg = registry();
+			std::scoped_lock lock(reg.mutex);
+			auto dead = [](const auto& ring) { return ring->dead.load(std::memory_order_acquire); };
+			std::shared_ptr<Ring> reused;
+			if (static_cast<size_t>(std::count_if(reg.rings.begin(), reg.rings.end(), dead)) >= MAX_DEAD_RINGS) {
+				auto it = std::find_if(reg.rings.begin(), reg.rings.end(), dead);
+				reused = *it;
+				reg.rings.erase(it);
+				std::scoped_lock ring_lock(reused->mutex);
+				reused->next = 0;
+				reused->dead.store(false, std::memory_order_relaxed);
+			}
+			else {
+				reused = std::make_shared<Ring>();
+				reused->records.resize(RING_CAPACITY);
+			}
+			{
+				std::scoped_lock ring_lock(reused->mutex);
+				reused->name = thread_name;
+				reused->tid = reg.next_tid++;
+			}
+			reg.rings.push_back(reused);
+			thread_ring.ring = std::move(reused);
+		}
+		return *thread_ring.ring;
+	}
+
+	void writeString(std::ostream& out, std::string_view text) {
+		out << '"';
+		for (char c : text) {
+			if (c == '"' || c == '\\')
+				out << '\\';
+			if (static_cast<unsigned char>(c) >= 0x20)
+				out << c;
+		}
+		out << '"';
+	}
+
+	void writeRecord(std::ostream& out, const Record& record, size_t tid, int64_t epoch) {
+		const char* name = "receive";
+		const char* phase = "B";
+		const char* category = "receive";
+		bool async_event = false;
+		switch (record.event) {
+		case TraceEvent::ReceiveBegin: break;
+		case TraceEvent::ReceiveEnd: phase = "E"; break;
+		case TraceEvent::BlockOpen: name = "block"; phase = "b"; category = "block"; async_event = true; break;
+		case TraceEvent::BlockFlush: name = "block"; phase = "e"; category = "block"; async_event = true; break;
+		case TraceEvent::Enqueue: name = record.label; phase = "b"; category = "queue"; async_event = true; break;
+		case TraceEvent::Dequeue: name = record.label; phase = "e"; category = "queue"; async_event = true; break;
+		case TraceEvent::WriteBegin: name = record.label; category = "write"; break;
+		case TraceEvent::WriteEnd: name = record.label; phase = "E"; category = "write"; break;
+		}
+		out << "{\"name\":";
+		writeString(out, name ? name : "");
+		out << ",\"cat\":\"" << category << "\",\"ph\":\"" << phase << "\",\"pid\":1,\"tid\":" << tid
+			<< ",\"ts\":" << static_cast<double>(record.ns - epoch) / 1000.0;
+		if (async_event)
+			out << ",\"id\":\"" << record.a << "-" << record.b << "\",\"args\":{\"handle\":" << record.a << ",\"seq\":" << record.b << "}";
+		else if (record.event == TraceEvent::ReceiveBegin)
+			out << ",\"args\":{\"handle\":" << record.a << ",\"bytes\":" << record.b << "}";
+		else if (record.event == TraceEvent::WriteBegin)
+			out << ",\"args\":{\"blocks\":" << record.a << "}";
+		out << "}";
+	}
+}
+
+void Tracer::enable(bool on)
+{
+	enabled_.store(on, std::memory_order_relaxed);
+}
+
+void Tracer::record(TraceEvent event, const char* label, uint64_t a, uint64_t b)
+{
+	Ring& current = ring();
+	int64_t ns = fastNowNs();
+	std::scoped_lock lock(current.mutex);
+	current.records[current.next++ % RING_CAPACITY] = { ns, a, b, label, event };
+}
+
+void Tracer::nameThread(std::string name)
+{
+	thread_name = std::move(name);
+	if (thread_ring.ring) {
+		std::scoped_lock lock(thread_ring.ring->mutex);
+		thread_ring.ring->name = thread_name;
+	}
+}
+
+const char* Tracer::intern(std::string_view text)
+{
+	auto& reg = registry();
+	std::scoped_lock lock(reg.mutex);
+	auto it = reg.labels.find(text);
+	if (it == reg.labels.end())
+		it = reg.labels.emplace(text).first;
+	return it->c_str();
+}
+
+void Tracer::write(std::ostream& out)
+{
+	std::vector<std::shared_ptr<Ring>> rings;
+	{
+		auto& reg = registry();
+		std::scoped_lock lock(reg.mutex);
+		rings = reg.rings;
+	}
+
+	std::vector<std::vector<Record>> snapshots(rings.size());
+	std::vector<size_t> dead; // tid буферов, владельцы которых завершились до снимка
+	int64_t epoch = INT64_MAX;
+	for (size_t i = 0; i < rings.size(); ++i) {
+		std::scoped_lock lock(rings[i]->mutex);
+		if (rings[i]->dead.load(std::memory_order_acquire))
+			dead.push_back(rings[i]->tid);
+		size_t count = std::min(rings[i]->next, RING_CAPACITY);
+		for (size_t n = rings[i]->next - count; n < rings[i]->next; ++n)
+			snapshots[i].push_back(rings[i]->records[n % RING_CAPACITY]);
+		if (!snapshots[i].empty())
+			epoch = std::min(epoch, snapshots[i].front().ns);
+	}
+
+	out << "{\"traceEvents\":[\n";
+	bool first = true;
+	for (size_t i = 0; i < rings.size(); ++i) {
+		std::string name;
+		{
+			std::scoped_lock lock(rings[i]->mutex);
+			name = rings[i]->name.empty() ? "thread " + std::to_string(rings[i]->tid) : rings[i]->name;
+		}
+		out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << rings[i]->tid << ",\"args\":{\"name\":";
+		writeString(out, name);
+		out << "}}";
+		first = false;
+		for (const auto& record : snapshots[i]) {
+			out << ",\n";
+			writeRecord(out, record, rings[i]->tid, epoch);
+		}
+	}
+	out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+
+	// События завершившихся потоков выгружены, их буферы больше не нужны
+	auto& reg = registry();
+	std::scoped_lock lock(reg.mutex);
+	std::erase_if(reg.rings, [&](const auto& ring) {
+		return ring->dead.load(std::memory_order_acquire) && std::ranges::find(dead, ring->tid) != dead.end();
+	});
+}
+
+bool Tracer::dump(const std::string& path)
+{
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out)
+		return false;
+	write(out);
+	return static_cast<bool>(out.flush());
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+/**
+ * @file Trace.h
+ * @brief Трассировка жизненного цикла команд и блоков в формате Chrome Trace
+ */
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+/**
+ * @enum TraceEvent
+ * @brief Тип события трассировки
+ */
+enum class TraceEvent : uint8_t
+{
+	ReceiveBegin, ///< Вход в async::receive (a - процессор, b - размер данных)
+	ReceiveEnd,   ///< Выход из async::receive (a - процессор)
+	BlockOpen,    ///< Первая команда блока (a - процессор, b - номер блока)
+	BlockFlush,   ///< Блок сформирован и отправлен в очереди (a - процессор, b - номер блока)
+	Enqueue,      ///< Блок помещен в очередь приемника label (a - процессор, b - номер блока)
+	Dequeue,      ///< Блок извлечен из очереди приемника label (a - процессор, b - номер блока)
+	WriteBegin,   ///< Начало записи пачки приемником label (a - количество блоков)
+	WriteEnd      ///< Конец записи пачки приемником label
+};
+
+/**
+ * @class Tracer
+ * @brief Запись событий в кольцевые буферы потоков и выгрузка их в JSON Chrome Trace.
+ *
+ * Каждый поток пишет в собственный кольцевой буфер, создаваемый при первом событии;
+ * при переполнении старые события затираются. Буфер завершившегося потока хранится
+ * до ближайшей выгрузки (но не более 16 таких буферов, дальше они переходят к новым потокам).
+ * Пока трассировка выключена, макрос
+ * ASYNC_TRACE сводится к чтению атомарного флага и хорошо предсказуемому переходу,
+ * а при сборке с ASYNC_NO_TRACE не порождает кода вовсе.
+ * Результат открывается в chrome://tracing или ui.perfetto.dev.
+ */
+class Tracer
+{
+public:
+	/**
+	* @brief Проверяет, включена ли трассировка
+	*/
+	static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+	/**
+	* @brief Включает или выключает запись событий
+	*/
+	static void enable(bool on);
+
+	/**
+	* @brief Записывает событие в буфер текущего потока
+	* @param event Тип события
+	* @param label Имя приемника для событий очереди и записи; строка должна жить до выгрузки (см. intern)
+	* @param a Первый аргумент события
+	* @param b Второй аргумент события
+	*/
+	static void record(TraceEvent event, const char* label, uint64_t a, uint64_t b);
+
+	/**
+	* @brief Задает имя текущего потока, отображаемое в трассе
+	*/
+	static void nameThread(std::string name);
+
+	/**
+	* @brief Возвращает постоянную копию строки, пригодную для передачи в record
+	*/
+	static const char* intern(std::string_view text);
+
+	/**
+	* @brief Выгружает накопленные события всех потоков в формате Chrome Trace JSON
+	*/
+	static void write(std::ostream& out);
+
+	/**
+	* @brief Выгружает накопленные события в файл
+	* @return false если файл не удалось записать
+	*/
+	static bool dump(const std::string& path);
+
+private:
+	static inline std::atomic<bool> enabled_{ false }; ///< Флаг записи событий
+};
+
+#ifdef ASYNC_NO_TRACE
+#define ASYNC_TRACE(event, label, a, b) do {} while (0)
+#else
+/// @brief Записывает событие, если трассировка включена
+#define ASYNC_TRACE(event, label, a, b) \
+	do { if (Tracer::enabled()) [[unlikely]] Tracer::record(event, label, a, b); } while (0)
+#endif
\ No newline at end of file
@@ -8,28 +8,78 @@
 #include <string>
 #include <iostream>
 #include "MultiThreadOutputter.h"
-#include <thread>
+#include "Trace.h"
+#include "BlockJournal.h"
+#include <mutex>
+
+namespace {
+	std::mutex config_mutex;
+	std::filesystem::path journal_dir = "journal"; ///< Каталог журналов сессий из последнего init
+}
 
 namespace async {
+	void init(const Config& config) {
+		{
+			std::scoped_lock lock(config_mutex);
+			journal_dir = config.journal_dir;
+		}
+		MultiThreadOutputter::init(config);
+	}
+
+	void shutdown() {
+		MultiThreadOutputter::shutdown();
+	}
+
+	std::string report() {
+		return MultiThreadOutputter::report();
+	}
+
+	void trace(bool enable) {
+		Tracer::enable(enable);
+	}
+
+	bool dump_trace(const std::string& path) {
+		return Tracer::dump(path);
+	}
+
 	HANDLE connect(size_t packSize) {
 		return new BulkProcessor(packSize);
 	}
 
+	HANDLE connect(size_t packSize, const ConnectOptions& options) {
+		auto processor = new BulkProcessor(packSize, options.weight, options.memory_limit);
+		if (!options.session.empty()) {
+			std::filesystem::path dir;
+			{
+				std::scoped_lock lock(config_mutex);
+				dir = journal_dir;
+			}
+			processor->attach(BlockJournal::pathFor(dir, options.session));
+		}
+		return processor;
+	}
+
 	void receive(HANDLE handle, const char* data, size_t size) {
 		if (!handle || !data || size == 0)
 			return;
 		auto processor = static_cast<BulkProcessor*>(handle);
-		std::string input(data, size);
-		processor->parse(input);
+		ASYNC_TRACE(TraceEvent::ReceiveBegin, nullptr, processor->id(), size);
+		processor->parse(std::string_view(data, size));
+		ASYNC_TRACE(TraceEvent::ReceiveEnd, nullptr, processor->id(), 0);
+	}
+
+	size_t memory(HANDLE handle) {
+		return handle ? static_cast<BulkProcessor*>(handle)->memory() : 0;
 	}
 
-	void disconnect(HANDLE handle) {
+	bool disconnect(HANDLE handle) {
 		if (!handle)
-			return;
+			return true;
 		auto processor = static_cast<BulkProcessor*>(handle);
 		processor->finalize();
-		while (!MultiThreadOutputter::getInstance().log_queue.empty() || !MultiThreadOutputter::getInstance().file_queue.empty())
-			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		processor->wait_idle();
+		bool written = processor->failed() == 0;
 		delete processor;
+		return written;
 	}
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 
 #pragma once
 #include <cstddef>
+#include <string>
 
 namespace async {
 	/**
@@ -12,6 +13,68 @@ namespace async {
 	*/
 	using HANDLE = void*;
 
+	/**
+	* @struct Config
+	* @brief Параметры библиотеки
+	*/
+	struct Config
+	{
+		std::string sinks; ///< Приемники блоков; пустая строка - значение ASYNC_SINKS или "console,file:threads=2"
+		bool inline_mode{ false }; ///< Писать блоки синхронно в вызывающем потоке, без рабочих потоков (также ASYNC_INLINE=1)
+		std::string journal_dir{ "journal" }; ///< Каталог журналов открытых блоков сессий (см. ConnectOptions::session)
+		std::string trace; ///< Файл трассировки: непустой путь включает трассировку и выгрузку при shutdown (также ASYNC_TRACE=<путь>)
+	};
+
+	/**
+	* @brief Инициализирует библиотеку и запускает рабочие потоки приемников
+	* @param config Параметры библиотеки
+	* @details Вызов необязателен: при первом сформированном блоке библиотека инициализируется
+	*          параметрами по умолчанию (с учетом переменных окружения ASYNC_SINKS и ASYNC_INLINE).
+	*          Повторный вызов дожидается записи всех блоков и переинициализирует библиотеку.
+	*/
+	void init(const Config& config = {});
+
+	/**
+	* @brief Дожидается записи всех отправленных блоков и останавливает рабочие потоки
+	* @details Вызывается после disconnect всех процессоров. Блок, сформированный после shutdown
+	*          (например, при disconnect процессора с открытым блоком), снова запускает библиотеку
+	*          с параметрами последнего init.
+	*/
+	void shutdown();
+
+	/**
+	* @brief Возвращает сводку по рабочим потокам приемников
+	* @details По строке на поток: привязка к процессорам, процессор последней записи,
+	*          количество записанных блоков и пачек, количество смен процессора.
+	*          Пустая строка, если библиотека не запущена; вызов ее не запускает.
+	*/
+	std::string report();
+
+	/**
+	* @brief Включает или выключает запись событий трассировки
+	* @details Записываются вход и выход из receive, открытие и отправка блоков,
+	*          постановка в очереди приемников и извлечение из них, запись пачек приемниками.
+	*/
+	void trace(bool enable);
+
+	/**
+	* @brief Выгружает накопленные события трассировки в формате Chrome Trace JSON
+	* @param path Путь к файлу (открывается в chrome://tracing или ui.perfetto.dev)
+	* @return false если файл не удалось записать
+	*/
+	bool dump_trace(const std::string& path);
+
+	/**
+	* @struct ConnectOptions
+	* @brief Параметры процессора команд
+	*/
+	struct ConnectOptions
+	{
+		size_t weight{ 1 }; ///< Вес процессора: доля пропускной способности записи относительно других процессоров
+		std::string session; ///< Постоянный идентификатор сессии: непустой включает журнал открытого блока
+		size_t memory_limit{ 0 }; ///< Бюджет памяти процессора в байтах (0 - без ограничения), см. memory()
+	};
+
 	/**
 	* @brief Создает новый процессор команд
 	* @param packSize Размер блока команд
@@ -19,6 +82,18 @@ namespace async {
 	*/
 	HANDLE connect(size_t packSize);
 
+	/**
+	* @brief Создает новый процессор команд с дополнительными параметрами
+	* @param packSize Размер блока команд
+	* @param options Параметры процессора
+	* @return Указатель на созданный процессор
+	* @details Если задан options.session, изменения открытого блока записываются в журнал сессии
+	*          в каталоге Config::journal_dir. Подключение с тем же идентификатором после перезапуска
+	*          восстанавливает из журнала команды и глубину вложенности незавершенного блока,
+	*          в том числе динамического блока, оставшегося открытым при disconnect.
+	*/
+	HANDLE connect(size_t packSize, const ConnectOptions& options);
+
 	/**
 	 * @brief Передает данные для обработки
 	 * @param handle Указатель на процессор
@@ -27,9 +102,21 @@ namespace async {
 	 */
 	void receive(HANDLE handle, const char* data, size_t size);
 
+	/**
+	 * @brief Возвращает память, занятую процессором
+	 * @param handle Указатель на процессор
+	 * @return Байты открытого блока и отправленных блоков, еще не освобожденных приемниками
+	 * @details При заданном ConnectOptions::memory_limit открытый блок, превысивший половину бюджета,
+	 *          передается досрочно (динамический блок - частями), а receive ожидает, пока отправленные
+	 *          блоки процессора занимают больше половины бюджета.
+	 */
+	size_t memory(HANDLE handle);
+
 	/**
 	 * @brief Завершает работу процессора
 	 * @param handle Указатель на процессор
+	 * @return false если часть блоков процессора приемники не смогли записать
+	 * @details Дожидается записи блоков этого процессора, но не блоков других процессоров.
 	 */
-	void disconnect(HANDLE handle);
+	bool disconnect(HANDLE handle);
 }
\ No newline at end of file
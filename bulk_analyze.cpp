@@ -0,0 +1,501 @@
+/**
+* @file bulk_analyze.cpp
+* @brief Параллельный анализ каталога журналов: блоки и команды по секундам, размеры блоков, задержки, баланс потоков
+*/
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "BlockRecord.h"
+#include "Lz4.h"
+#include "ThreadSafeQueue.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ANALYZE_HAS_MMAP
+#endif
+
+namespace RESULT {
+	enum CODE
+	{
+		OK,
+		ARGUMENT_PARSE_ERROR,
+		FILE_OPENING_ERROR
+	};
+}
+
+/// @brief Файлы меньше этого размера читаются в буфер потока: отображение крошечного файла дороже чтения
+constexpr size_t ANALYZE_MMAP_THRESHOLD = 64 << 10;
+
+/// @brief Количество файлов в одной задаче
+constexpr size_t ANALYZE_BATCH = 256;
+
+/// @brief Счетчики одного потока записи (file1, file2, segment1, ...)
+struct WriterStats
+{
+	size_t files{ 0 };
+	size_t blocks{ 0 };
+	size_t commands{ 0 };
+	size_t bytes{ 0 };
+};
+
+/// @brief Распределение задержек по степеням двойки наносекунд
+struct LatencyStats
+{
+	std::array<size_t, 64> buckets{}; ///< Корзина k - задержки в [2^k, 2^(k+1)) нс, корзина 0 - также нулевые
+	size_t count{ 0 };
+	int64_t max{ 0 };
+
+	/// @brief Учитывает задержку; отрицательные (часы разных машин или сбой) пропускаются
+	void add(int64_t ns) {
+		if (ns < 0)
+			return;
+		++buckets[ns ? std::bit_width(static_cast<uint64_t>(ns)) - 1 : 0];
+		++count;
+		max = std::max(max, ns);
+	}
+
+	/// @brief Добавляет распределение другого потока анализа
+	void merge(const LatencyStats& other) {
+		for (size_t i = 0; i < buckets.size(); ++i)
+			buckets[i] += other.buckets[i];
+		count += other.count;
+		max = std::max(max, other.max);
+	}
+
+	/// @brief Возвращает верхнюю границу корзины, в которую попадает доля share задержек
+	int64_t percentile(double share) const {
+		size_t threshold = static_cast<size_t>(share * static_cast<double>(count));
+		size_t seen = 0;
+		for (size_t i = 0; i < buckets.size(); ++i) {
+			seen += buckets[i];
+			if (seen > threshold)
+				return std::min(max, i >= 62 ? max : (int64_t{ 2 } << i) - 1);
+		}
+		return max;
+	}
+};
+
+/// @brief Агрегаты по набору файлов
+struct AnalyzeStats
+{
+	size_t files{ 0 };
+	size_t blocks{ 0 };
+	size_t commands{ 0 };
+	size_t bytes{ 0 };
+	size_t errors{ 0 };
+	std::unordered_map<int64_t, std::pair<size_t, size_t>> seconds; ///< Секунда -> (блоки, команды)
+	std::map<size_t, size_t> sizes; ///< Команд в блоке -> количество блоков
+	std::map<std::string, WriterStats> writers; ///< Поток записи -> счетчики
+	LatencyStats open; ///< Первая команда блока -> отправка в приемники
+	LatencyStats delivery; ///< Отправка в приемники -> запись (только двоичные записи)
+
+	/// @brief Добавляет агрегаты другого потока анализа
+	void merge(const AnalyzeStats& other) {
+		files += other.files;
+		blocks += other.blocks;
+		commands += other.commands;
+		bytes += other.bytes;
+		errors += other.errors;
+		for (const auto& [second, counts] : other.seconds) {
+			seconds[second].first += counts.first;
+			seconds[second].second += counts.second;
+		}
+		for (const auto& [size, count] : other.sizes)
+			sizes[size] += count;
+		for (const auto& [name, writer] : other.writers) {
+			auto& target = writers[name];
+			target.files += writer.files;
+			target.blocks += writer.blocks;
+			target.commands += writer.commands;
+			target.bytes += writer.bytes;
+		}
+		open.merge(other.open);
+		delivery.merge(other.delivery);
+	}
+};
+
+/// @brief Задача анализа: каталог для обхода либо пачка файлов
+struct AnalyzeTask
+{
+	std::filesystem::path directory; ///< Каталог (пустой, если задача - пачка файлов)
+	std::vector<std::filesystem::path> files; ///< Файлы пачки
+};
+
+/// @brief Читает число в начале строки
+/// @return -1 если строка не начинается с цифры
+int64_t leading_number(std::string_view text)
+{
+	int64_t value = -1;
+	std::from_chars(text.data(), text.data() + text.size(), value);
+	return value;
+}
+
+/// @brief Определяет по имени файла время, задержку блока и поток записи
+/// @param name Имя файла: bulk<ts>_threadID_<N>_<counter>_<handle>-<seq>[_<created_ns>_<flushed_ns>].log
+///             или segment_<ts>_<N>_...
+/// @param second Время создания файла (секунды) либо -1
+/// @param open_ns Время от первой команды до отправки блока, если оно есть в имени, иначе -1
+/// @param writer Имя потока записи: file<N>, segment<N> или other
+void parse_name(std::string_view name, int64_t& second, int64_t& open_ns, std::string& writer)
+{
+	second = -1;
+	open_ns = -1;
+	writer = "other";
+	if (name.starts_with("bulk")) {
+		second = leading_number(name.substr(4));
+		size_t pos = name.find("_threadID_");
+		if (pos == std::string_view::npos)
+			return;
+		writer = "file" + std::to_string(leading_number(name.substr(pos + 10)));
+		// Поля после _threadID_: N, counter, handle-seq, created_ns, flushed_ns.
+		// Старые имена (bulk<ts>_threadID_<N>_<rand>.log) времен не содержат
+		std::string_view rest = name.substr(pos + 10);
+		rest = rest.substr(0, rest.rfind('.'));
+		std::vector<std::string_view> fields;
+		for (size_t start = 0;;) {
+			size_t end = rest.find('_', start);
+			fields.push_back(rest.substr(start, end - start));
+			if (end == std::string_view::npos)
+				break;
+			start = end + 1;
+		}
+		if (fields.size() != 5 || fields[2].find('-') == std::string_view::npos)
+			return;
+		int64_t created_ns = leading_number(fields[3]);
+		int64_t flushed_ns = leading_number(fields[4]);
+		if (created_ns > 0 && flushed_ns >= created_ns) {
+			second = created_ns / 1000000000;
+			open_ns = flushed_ns - created_ns;
+		}
+	}
+	else if (name.starts_with("segment_")) {
+		second = leading_number(name.substr(8));
+		if (size_t pos = name.find('_', 8); pos != std::string_view::npos)
+			writer = "segment" + std::to_string(leading_number(name.substr(pos + 1)));
+	}
+}
+
+/// @brief Учитывает блок в распределении по секундам
+void count_second(AnalyzeStats& stats, int64_t second, size_t blocks, size_t commands)
+{
+	if (second >= 0 && blocks) {
+		auto& counts = stats.seconds[second];
+		counts.first += blocks;
+		counts.second += commands;
+	}
+}
+
+/// @brief Разбирает двоичные записи: секунда берется из времени создания каждого блока
+/// @param data Содержимое после сигнатуры
+void parse_records(std::string_view data, WriterStats& writer, AnalyzeStats& stats)
+{
+	BlockRecord record;
+	while (!data.empty()) {
+		if (!readBlockRecord(data, record)) {
+			++stats.errors;
+			return;
+		}
+		size_t count = record.commands.size();
+		++stats.sizes[count];
+		++stats.blocks;
+		stats.commands += count;
+		++writer.blocks;
+		writer.commands += count;
+		count_second(stats, record.created_ns / 1000000000, 1, count);
+		stats.open.add(record.flushed_ns - record.created_ns);
+		stats.delivery.add(record.written_ns - record.flushed_ns);
+	}
+}
+
+/// @brief Разбирает строки "bulk: a, b, c" содержимого файла
+void parse_content(std::string_view data, int64_t second, WriterStats& writer, AnalyzeStats& stats)
+{
+	if (data.starts_with(BLOCK_RECORD_MAGIC)) {
+		parse_records(data.substr(BLOCK_RECORD_MAGIC.size()), writer, stats);
+		return;
+	}
+	size_t blocks = 0;
+	size_t commands = 0;
+	while (!data.empty()) {
+		size_t end = data.find('\n');
+		std::string_view line = data.substr(0, end);
+		data = end == std::string_view::npos ? std::string_view{} : data.substr(end + 1);
+		if (!line.starts_with("bulk: "))
+			continue;
+		size_t count = 1;
+		for (size_t pos = line.find(", ", 6); pos != std::string_view::npos; pos = line.find(", ", pos + 2))
+			++count;
+		++stats.sizes[count];
+		++blocks;
+		commands += count;
+	}
+	stats.blocks += blocks;
+	stats.commands += commands;
+	writer.blocks += blocks;
+	writer.commands += commands;
+	count_second(stats, second, blocks, commands);
+}
+
+/// @brief Читает файл (отображая крупные файлы в память) и передает содержимое в parse_content
+/// @param buffer Буфер потока для мелких и сжатых файлов
+/// @return false если файл не удалось прочитать
+bool analyze_file(const std::filesystem::path& path, std::string& buffer, std::string& unpacked, AnalyzeStats& stats)
+{
+	int64_t second;
+	int64_t open_ns;
+	std::string name;
+	parse_name(path.filename().string(), second, open_ns, name);
+	auto handle = [&](std::string_view data) {
+		WriterStats& writer = stats.writers[name];
+		++writer.files;
+		writer.bytes += data.size();
+		++stats.files;
+		stats.bytes += data.size();
+		if (lz4IsFrame(data)) {
+			unpacked.clear();
+			if (!lz4ReadFrames(data, unpacked))
+				++stats.errors;
+			data = unpacked;
+		}
+		parse_content(data, second, writer, stats);
+		stats.open.add(open_ns);
+	};
+#ifdef ANALYZE_HAS_MMAP
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+	struct stat st {};
+	if (::fstat(fd, &st) != 0) {
+		::close(fd);
+		return false;
+	}
+	size_t size = static_cast<size_t>(st.st_size);
+	if (size >= ANALYZE_MMAP_THRESHOLD) {
+		void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (mapped == MAP_FAILED)
+			return false;
+		::madvise(mapped, size, MADV_SEQUENTIAL);
+		handle(std::string_view(static_cast<const char*>(mapped), size));
+		::munmap(mapped, size);
+		return true;
+	}
+	buffer.resize(size);
+	size_t filled = 0;
+	while (filled < size) {
+		ssize_t read = ::read(fd, buffer.data() + filled, size - filled);
+		if (read <= 0)
+			break;
+		filled += static_cast<size_t>(read);
+	}
+	::close(fd);
+	handle(std::string_view(buffer.data(), filled));
+	return true;
+#else
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+	buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	handle(buffer);
+	return true;
+#endif
+}
+
+/// @brief Обходит каталоги и анализирует файлы пулом потоков
+/// @param roots Каталоги и файлы для анализа
+/// @param workers Количество потоков
+AnalyzeStats analyze(const std::vector<std::filesystem::path>& roots, size_t workers)
+{
+	ThreadSafeQueue<AnalyzeTask> tasks;
+	std::atomic<size_t> pending{ 0 };
+	auto submit = [&](AnalyzeTask task) {
+		pending.fetch_add(1, std::memory_order_relaxed);
+		tasks.push(std::move(task));
+	};
+
+	AnalyzeTask loose;
+	for (const auto& root : roots) {
+		std::error_code ec;
+		if (std::filesystem::is_directory(root, ec))
+			submit({ root, {} });
+		else
+			loose.files.push_back(root);
+	}
+	if (!loose.files.empty())
+		submit(std::move(loose));
+	if (pending.load() == 0)
+		return {};
+
+	std::vector<AnalyzeStats> results(workers);
+	std::vector<std::jthread> pool;
+	for (size_t i = 0; i < workers; ++i) {
+		pool.emplace_back([&, i](std::stop_token stoken) {
+			AnalyzeStats& stats = results[i];
+			std::string buffer;
+			std::string unpacked;
+			std::vector<AnalyzeTask> taken;
+			while (tasks.wait_and_pop_batch(taken, 1, stoken)) {
+				for (auto& task : taken) {
+					if (!task.directory.empty()) { // Подкаталоги и пачки файлов становятся новыми задачами
+						AnalyzeTask batch;
+						std::error_code ec;
+						for (std::filesystem::directory_iterator it(task.directory, ec), end; !ec && it != end; it.increment(ec)) {
+							if (it->is_directory(ec))
+								submit({ it->path(), {} });
+							else {
+								batch.files.push_back(it->path());
+								if (batch.files.size() == ANALYZE_BATCH)
+									submit(std::exchange(batch, {}));
+							}
+						}
+						if (ec)
+							++stats.errors;
+						if (!batch.files.empty())
+							submit(std::move(batch));
+					}
+					for (const auto& file : task.files) {
+						if (!analyze_file(file, buffer, unpacked, stats))
+							++stats.errors;
+					}
+					if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+						pending.notify_all();
+				}
+				taken.clear();
+			}
+			});
+	}
+	for (size_t left = pending.load(); left != 0; left = pending.load())
+		pending.wait(left);
+	for (auto& thread : pool)
+		thread.request_stop();
+	pool.clear();
+
+	AnalyzeStats total;
+	for (const auto& result : results)
+		total.merge(result);
+	return total;
+}
+
+/// @brief Возвращает размер блока, не меньше которого имеет доля blocks блоков
+size_t size_percentile(const std::map<size_t, size_t>& sizes, size_t blocks, double share)
+{
+	size_t threshold = static_cast<size_t>(share * static_cast<double>(blocks));
+	size_t seen = 0;
+	for (const auto& [size, count] : sizes) {
+		seen += count;
+		if (seen > threshold)
+			return size;
+	}
+	return sizes.empty() ? 0 : sizes.rbegin()->first;
+}
+
+/// @brief Выводит строку распределения задержек
+void print_latency(std::ostream& out, std::string_view name, const LatencyStats& latency)
+{
+	if (!latency.count)
+		return;
+	out << name << " latency (ns, upper bound): p50 " << latency.percentile(0.5) << ", p90 " << latency.percentile(0.9)
+		<< ", p99 " << latency.percentile(0.99) << ", max " << latency.max << " (" << latency.count << " blocks)\n";
+}
+
+/// @brief Выводит отчет
+void print_report(std::ostream& out, const AnalyzeStats& stats, bool per_second)
+{
+	out << "files: " << stats.files << ", blocks: " << stats.blocks << ", commands: " << stats.commands
+		<< ", bytes: " << stats.bytes << ", errors: " << stats.errors << "\n";
+
+	std::vector<std::pair<int64_t, std::pair<size_t, size_t>>> seconds(stats.seconds.begin(), stats.seconds.end());
+	std::sort(seconds.begin(), seconds.end());
+	if (!seconds.empty()) {
+		int64_t first = seconds.front().first;
+		int64_t last = seconds.back().first;
+		double span = static_cast<double>(last - first + 1);
+		auto peak = std::max_element(seconds.begin(), seconds.end(),
+			[](const auto& a, const auto& b) { return a.second.first < b.second.first; });
+		int64_t gap_seconds = 0;
+		int64_t longest = 0;
+		int64_t longest_at = first;
+		for (size_t i = 1; i < seconds.size(); ++i) {
+			int64_t gap = seconds[i].first - seconds[i - 1].first - 1;
+			gap_seconds += gap;
+			if (gap > longest) {
+				longest = gap;
+				longest_at = seconds[i - 1].first + 1;
+			}
+		}
+		out << "time: " << first << ".." << last << " (" << last - first + 1 << " s), blocks/s: "
+			<< static_cast<double>(stats.blocks) / span << ", commands/s: " << static_cast<double>(stats.commands) / span
+			<< ", peak: " << peak->second.first << " blocks at " << peak->first << "\n";
+		out << "gaps: " << gap_seconds << " s without blocks";
+		if (longest)
+			out << ", longest " << longest << " s from " << longest_at;
+		out << "\n";
+		if (per_second) {
+			out << "per second (time blocks commands):\n";
+			for (const auto& [second, counts] : seconds)
+				out << "\t" << second << " " << counts.first << " " << counts.second << "\n";
+		}
+	}
+
+	if (!stats.sizes.empty()) {
+		out << "block size: min " << stats.sizes.begin()->first
+			<< ", p50 " << size_percentile(stats.sizes, stats.blocks, 0.5)
+			<< ", p90 " << size_percentile(stats.sizes, stats.blocks, 0.9)
+			<< ", p99 " << size_percentile(stats.sizes, stats.blocks, 0.99)
+			<< ", max " << stats.sizes.rbegin()->first << "\n";
+		for (const auto& [size, count] : stats.sizes)
+			out << "\t" << size << " commands: " << count << " blocks\n";
+	}
+
+	print_latency(out, "open", stats.open);
+	print_latency(out, "delivery", stats.delivery);
+
+	out << "writers (files blocks commands bytes share of blocks):\n";
+	for (const auto& [name, writer] : stats.writers) {
+		double share = stats.blocks ? 100.0 * static_cast<double>(writer.blocks) / static_cast<double>(stats.blocks) : 0.0;
+		out << "\t" << name << " " << writer.files << " " << writer.blocks << " " << writer.commands << " "
+			<< writer.bytes << " " << share << "%\n";
+	}
+}
+
+/// Использование: bulk_analyze [-j N] [--per-second] <dir|file>...
+int main(int argc, char* argv[]) {
+	size_t workers = std::max(1u, std::thread::hardware_concurrency());
+	bool per_second = false;
+	std::vector<std::filesystem::path> roots;
+	for (int i = 1; i < argc; ++i) {
+		std::string_view arg = argv[i];
+		if (arg == "-j" && i + 1 < argc)
+			workers = std::max<int64_t>(1, leading_number(argv[++i]));
+		else if (arg == "--per-second")
+			per_second = true;
+		else
+			roots.emplace_back(arg);
+	}
+	if (roots.empty()) {
+		std::cerr << "Usage: bulk_analyze [-j N] [--per-second] <dir|file>..." << std::endl;
+		return RESULT::ARGUMENT_PARSE_ERROR;
+	}
+	AnalyzeStats stats = analyze(roots, workers);
+	print_report(std::cout, stats, per_second);
+	return stats.errors ? RESULT::FILE_OPENING_ERROR : RESULT::OK;
+}
\ No newline at end of file
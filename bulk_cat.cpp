@@ -0,0 +1,112 @@
+/**
+* @file bulk_cat.cpp
+* @brief Вывод журналов приемников в стандартный поток с распаковкой сегментов LZ4 и двоичных записей
+*/
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "BlockRecord.h"
+#include "Lz4.h"
+
+namespace RESULT {
+	enum CODE
+	{
+		OK,
+		ARGUMENT_PARSE_ERROR,
+		FILE_OPENING_ERROR
+	};
+}
+
+/// @brief Выводит двоичные записи строками "bulk: ..."
+/// @param data Содержимое файла после сигнатуры
+/// @param times Предварять строку временами блока: handle-seq created_ns flushed_ns written_ns
+/// @return false если запись повреждена
+bool cat_records(std::string_view data, bool times)
+{
+	BlockRecord record;
+	std::string line;
+	while (!data.empty()) {
+		if (!readBlockRecord(data, record))
+			return false;
+		line.clear();
+		if (times) {
+			line += std::to_string(record.handle) + "-" + std::to_string(record.seq) + " " + std::to_string(record.created_ns)
+				+ " " + std::to_string(record.flushed_ns) + " " + std::to_string(record.written_ns) + " ";
+		}
+		line += "bulk: ";
+		for (size_t i = 0; i < record.commands.size(); ++i) {
+			if (i)
+				line += ", ";
+			line += record.commands[i];
+		}
+		line += '\n';
+		std::cout.write(line.data(), static_cast<std::streamsize>(line.size()));
+	}
+	return true;
+}
+
+/// @brief Выводит файл, распаковывая его, если он состоит из кадров LZ4 или двоичных записей
+/// @param times Выводить времена блоков из двоичных записей
+/// @return false если файл не удалось прочитать или распаковать
+bool cat_file(const std::filesystem::path& path, bool times)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		std::cerr << "Error opening file: " << path << std::endl;
+		return false;
+	}
+	std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	bool ok = true;
+	std::string unpacked;
+	std::string_view content = data;
+	if (lz4IsFrame(data)) {
+		ok = lz4ReadFrames(data, unpacked); // Неповрежденное начало выводится и при ошибке
+		if (!ok)
+			std::cerr << "Corrupted LZ4 data: " << path << std::endl;
+		content = unpacked;
+	}
+	if (!content.starts_with(BLOCK_RECORD_MAGIC)) {
+		std::cout.write(content.data(), static_cast<std::streamsize>(content.size()));
+		return ok;
+	}
+	if (!cat_records(content.substr(BLOCK_RECORD_MAGIC.size()), times)) {
+		std::cerr << "Corrupted block records: " << path << std::endl;
+		return false;
+	}
+	return ok;
+}
+
+/// Использование: bulk_cat [--times] <file|dir>... - каталоги выводятся по файлам в порядке имен
+int main(int argc, char* argv[]) {
+	bool times = argc > 1 && std::string_view(argv[1]) == "--times";
+	int first = times ? 2 : 1;
+	if (argc <= first) {
+		std::cerr << "Usage: bulk_cat [--times] <file|dir>..." << std::endl;
+		return RESULT::ARGUMENT_PARSE_ERROR;
+	}
+	bool ok = true;
+	for (int i = first; i < argc; ++i) {
+		std::filesystem::path path = argv[i];
+		std::error_code ec;
+		if (!std::filesystem::is_directory(path, ec)) {
+			ok = cat_file(path, times) && ok;
+			continue;
+		}
+		std::vector<std::filesystem::path> files;
+		for (const auto& entry : std::filesystem::directory_iterator(path, ec)) {
+			if (entry.is_regular_file())
+				files.push_back(entry.path());
+		}
+		std::sort(files.begin(), files.end());
+		for (const auto& file : files)
+			ok = cat_file(file, times) && ok;
+	}
+	std::cout.flush();
+	return ok ? RESULT::OK : RESULT::FILE_OPENING_ERROR;
+}
\ No newline at end of file
@@ -8,6 +8,10 @@
 #include <iostream>
 #include <fstream>
 #include "ProcessorCommands.h"
+#include "ParallelScriptExecutor.h"
+#include "Replay.h"
+#include <chrono>
+#include <string_view>
 #include <iosfwd>
 #include <thread>
 #include <vector>
@@ -45,10 +49,31 @@ void stress_test() {
 
 int main(int argc, char* argv[]) {
 #ifdef V2_DEMO_PROJECT
+	if (argc >= 3 && argc <= 4 && std::string_view(argv[2]) == "--replay") {
+		// Режим воспроизведения: вход передается в библиотеку крупными порциями
+		const char* path = argc == 4 ? argv[3] : "-";
+		async::init();
+		auto handle = async::connect(atoi(argv[1]));
+		auto start = std::chrono::steady_clock::now();
+		ReplayStats stats;
+		bool opened = replay(path, handle, stats);
+		async::disconnect(handle);
+		std::string placement = async::report();
+		async::shutdown();
+		stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (!opened) {
+			std::cerr << "Error: cannot open file '" << path << "'\n";
+			return RESULT::FILE_OPENING_ERROR;
+		}
+		print_replay_stats(std::cerr, stats);
+		std::cerr << placement;
+		return RESULT::OK;
+	}
 	if (argc != 2) {
-		std::cerr << "Usage: async <bulk_size>\n";
+		std::cerr << "Usage: async <bulk_size> [--replay [<file>|-]]\n";
 		return RESULT::ARGUMENT_PARSE_ERROR;
 	}
+	async::init();
 	auto handle = async::connect(atoi(argv[1]));
 	std::string line;
 	while (getline(std::cin, line)) {
@@ -56,6 +81,7 @@ int main(int argc, char* argv[]) {
 			async::receive(handle, line.data(), line.size());
 	}
 	async::disconnect(handle);
+	async::shutdown();
 
 	return RESULT::OK;
 #else
@@ -72,6 +98,14 @@ int main(int argc, char* argv[]) {
 		}
 		process_commands_from_stream(input_file, false);
 		break;
+	case 3: // Parallel file mode: <file> <jobs>
+		input_file.open(argv[1]);
+		if (!input_file.is_open()) {
+			std::cerr << "Error: cannot open file '" << argv[1] << "'\n";
+			return RESULT::FILE_OPENING_ERROR;
+		}
+		process_commands_parallel(input_file, static_cast<size_t>(atoi(argv[2])));
+		break;
 	default:
 		std::cerr << "Too many arguments " << std::endl;
 		return RESULT::ARGUMENT_PARSE_ERROR;